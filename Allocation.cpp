@@ -0,0 +1,80 @@
+#include "Profile.h"
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// Global allocation functions counting every allocation for --stats. They live apart from
+// the rest of the profiler: with their bodies visible next to code that allocates, the
+// compiler pairs the inlined free() with operator new and reports a mismatch.
+
+namespace {
+
+void* Allocate(size_t size){
+    Profile::RecordAllocation(size);
+    if(void* ptr = malloc(size ? size : 1)){
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+void* AllocateAligned(size_t size,align_val_t alignment){
+    Profile::RecordAllocation(size);
+    const size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    const size_t rounded = ((size ? size : 1) + align - 1) / align * align;
+    if(void* ptr = aligned_alloc(align,rounded)){
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+}
+
+void* operator new(size_t size){
+    return Allocate(size);
+}
+
+void* operator new[](size_t size){
+    return Allocate(size);
+}
+
+void* operator new(size_t size,align_val_t alignment){
+    return AllocateAligned(size,alignment);
+}
+
+void* operator new[](size_t size,align_val_t alignment){
+    return AllocateAligned(size,alignment);
+}
+
+void operator delete(void* ptr) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept{
+    free(ptr);
+}
+
+void operator delete(void* ptr, align_val_t) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t) noexcept{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t, align_val_t) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, align_val_t) noexcept{
+    free(ptr);
+}
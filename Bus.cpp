@@ -1,25 +1,17 @@
 #include "Bus.h"
+#include "parallel.h"
+#include <algorithm>
 
 using namespace std;
 
 BusManager::BusInfo BusManager::ProcessStops(const map<string,Json::Node>& request){
     BusInfo bus_info;
-    vector<string> route;
     const auto& stops = request.at("stops").AsArray();
+    bus_info.stops.reserve(stops.size());
     for(const auto& stop : stops){
-        route.push_back(stop.AsString());
+        bus_info.stops.push_back(stop.AsString());
     }
     bus_info.is_round_trip = request.at("is_roundtrip").AsBool();
-    if(!bus_info.is_round_trip && route.size() > 1){
-        vector<string> forward_route;
-        for(int i = route.size()-2 ; i >= 0; i--){
-            forward_route.push_back(route[i]);
-        }
-        for(int i = 0; i < forward_route.size(); i++){
-            route.push_back(forward_route[i]);
-        }
-    }
-    bus_info.stops_sequence = move(route);
     return bus_info;
 }
 
@@ -30,134 +22,223 @@ tuple<string,BusManager::BusInfo> BusManager::ProcessBusRequest(const map<string
 }
 
 void BusManager::AddBusToStop(const std::string& bus_num,const BusManager::BusInfo& bus_stops){
-    for(const auto& stop : bus_stops.stops_sequence){
+    for(const auto& stop : bus_stops.stops){
         stop_base_ptr_->AddStopBus(bus_num,stop);
     }
 }
 
 void BusManager::AddBus(const std::string& bus_name,const BusInfo& bus){
-    bus_data_[bus_name] = bus;
+    vector<size_t> stop_ids;
+    stop_ids.reserve(bus.stops.size());
+    for(const auto& stop : bus.stops){
+        stop_ids.push_back(stop_base_ptr_->GetOrCreateStop(stop).id);
+    }
+    bus_data_[bus_name] = InternPattern(move(stop_ids),bus.is_round_trip);
+}
+
+size_t BusManager::InternPattern(vector<size_t> stop_ids,bool is_round_trip){
+    size_t hash = is_round_trip;
+    for(size_t stop_id : stop_ids){
+        hash = hash * 1000003 + stop_id;
+    }
+    auto [begin,end] = pattern_ids_.equal_range(hash);
+    for(auto it = begin; it != end; ++it){
+        const RoutePattern& pattern = patterns_[it->second];
+        if(pattern.is_round_trip == is_round_trip && pattern.stop_ids == stop_ids){
+            return it->second;
+        }
+    }
+    RoutePattern& pattern = patterns_.emplace_back();
+    pattern.stop_ids = move(stop_ids);
+    pattern.is_round_trip = is_round_trip;
+    pattern_ids_.emplace(hash,patterns_.size() - 1);
+    all_bus_params_ready_ = false;
+    return patterns_.size() - 1;
 }
 
 void BusManager::AddBusRoutingSettings(const Json::Node& route_settings_node) {
+    route_settings_ = ReadRouteSettings(route_settings_node);
+}
+
+BusManager::RouteSettings BusManager::ReadRouteSettings(const Json::Node& route_settings_node) {
     const auto& settings_map = route_settings_node.AsMap();
-    route_settings_.bus_wait_time = settings_map.at("bus_wait_time").AsDouble();
-    route_settings_.bus_velocity = settings_map.at("bus_velocity").AsDouble() * 1000 / 60;
+    RouteSettings route_settings;
+    route_settings.bus_wait_time = settings_map.at("bus_wait_time").AsDouble();
+    route_settings.bus_velocity = settings_map.at("bus_velocity").AsDouble() * 1000 / 60;
+    return route_settings;
+}
+
+BusManager::RoutePattern* BusManager::FindPattern(const string& bus_num){
+    auto it = bus_data_.find(bus_num);
+    return it == bus_data_.end() ? nullptr : &patterns_[it->second];
+}
+
+const BusManager::RoutePattern* BusManager::FindPattern(const string& bus_num) const{
+    auto it = bus_data_.find(bus_num);
+    return it == bus_data_.end() ? nullptr : &patterns_[it->second];
 }
 
 double BusManager::CalculateAndSetGeographicalLength(const string& bus_num){
-    if(bus_data_.count(bus_num) == 0){
+    RoutePattern* pattern = FindPattern(bus_num);
+    if(!pattern){
         return 0.0;
     }
-    auto& bus_info = bus_data_.at(bus_num);
-    if(bus_info.geographical_length != 0){
-        return bus_info.geographical_length;
+    if(pattern->geographical_length == 0 && pattern->GetStopCount() >= 2){
+        CalculateGeographicalLengths({pattern});
     }
-    const auto& stops = bus_data_.at(bus_num).stops_sequence;
-    if(stops.size() < 2){
-        return 0.0;
+    return pattern->geographical_length;
+}
+
+void BusManager::CalculateAndSetAllGeographicalLengths(){
+    vector<RoutePattern*> patterns;
+    for(auto& pattern : patterns_){
+        if(pattern.geographical_length == 0 && pattern.GetStopCount() >= 2){
+            patterns.push_back(&pattern);
+        }
     }
-    double route_length = 0;
-    for(size_t i = 1; i < stops.size(); i++){
-        const auto coord1 = stop_base_ptr_->GetStopCoordinates(stops[i-1]);
-        const auto coord2 = stop_base_ptr_->GetStopCoordinates(stops[i]);
-        if(coord1 && coord2){
-            route_length += acos(sin(coord1->latitude) * sin(coord2->latitude) + cos(coord1->latitude) 
-            * cos(coord2->latitude) * cos(abs(coord1->longitude - coord2->longitude))) * Earth_Radius;
+    CalculateGeographicalLengths(patterns);
+}
+
+// Segments of all patterns go through the great-circle kernel as one batch.
+void BusManager::CalculateGeographicalLengths(const vector<RoutePattern*>& patterns) const{
+    vector<size_t> from_ids, to_ids;
+    vector<size_t> segment_ends;
+    segment_ends.reserve(patterns.size());
+    for(const RoutePattern* pattern : patterns){
+        AppendSegmentStopIds(*pattern,from_ids,to_ids);
+        segment_ends.push_back(from_ids.size());
+    }
+    vector<double> lengths(from_ids.size());
+    ComputeGreatCircleDistances(stop_base_ptr_->GetCoordinatesStore(),from_ids.data(),to_ids.data(),lengths.size(),lengths.data());
+    size_t segment = 0;
+    for(size_t idx = 0; idx < patterns.size(); idx++){
+        double route_length = 0;
+        for(; segment < segment_ends[idx]; segment++){
+            route_length += lengths[segment];
         }
+        patterns[idx]->geographical_length = route_length;
     }
-    bus_info.geographical_length = route_length;
-    return bus_info.geographical_length;
 }
 
-double BusManager::CalculateAndSetRoadLength(const std::string& bus_num){
-    if(bus_data_.count(bus_num) == 0){
-        return 0.0;
+void BusManager::CalculateAndSetAllBusParams(){
+    if(all_bus_params_ready_){
+        return;
     }
-    const auto& stops = bus_data_.at(bus_num).stops_sequence;
-    auto& bus_info = bus_data_.at(bus_num);
-    if(bus_info.road_length != 0.0){
-        return bus_info.road_length;
+    CalculateAndSetAllGeographicalLengths();
+    ParallelFor(patterns_.size(),[this](size_t idx){
+        CalculateBusParams(patterns_[idx]);
+    });
+    all_bus_params_ready_ = true;
+}
+
+void BusManager::CalculateBusParams(RoutePattern& pattern) const{
+    CalculateRoadLength(pattern);
+    if(pattern.curvature == 0.0){
+        pattern.curvature = pattern.road_length / pattern.geographical_length;
     }
-    if(stops.size() < 2){
-        return 0.0;
+    CalculateUniqueStopCount(pattern);
+    pattern.cnt_stops = pattern.GetStopCount();
+}
+
+void BusManager::AppendSegmentStopIds(const RoutePattern& pattern,vector<size_t>& from_ids,vector<size_t>& to_ids) const{
+    const size_t stop_count = pattern.GetStopCount();
+    for(size_t i = 1; i < stop_count; i++){
+        from_ids.push_back(pattern.GetStopId(i-1));
+        to_ids.push_back(pattern.GetStopId(i));
     }
+}
+
+void BusManager::CalculateRoadLength(RoutePattern& pattern) const{
+    if(pattern.road_length != 0.0){
+        return;
+    }
+    const size_t stop_count = pattern.GetStopCount();
     double road_length = 0;
-    for(size_t i = 1; i < stops.size(); i++){
-        const auto& stop1 = stops[i-1];
-        const auto& stop2 = stops[i];
-        road_length += stop_base_ptr_->GetDistance(stop1,stop2);
+    for(size_t i = 1; i < stop_count; i++){
+        road_length += stop_base_ptr_->GetDistance(pattern.GetStopId(i-1),pattern.GetStopId(i));
+    }
+    pattern.road_length = road_length;
+}
+
+void BusManager::CalculateUniqueStopCount(RoutePattern& pattern){
+    if(pattern.unique_stops != 0){
+        return;
+    }
+    vector<size_t> stop_ids = pattern.stop_ids;
+    sort(stop_ids.begin(),stop_ids.end());
+    pattern.unique_stops = unique(stop_ids.begin(),stop_ids.end()) - stop_ids.begin();
+}
+
+double BusManager::CalculateAndSetRoadLength(const std::string& bus_num){
+    RoutePattern* pattern = FindPattern(bus_num);
+    if(!pattern){
+        return 0.0;
     }
-    bus_info.road_length = road_length;
-    return bus_info.road_length;
+    CalculateRoadLength(*pattern);
+    return pattern->road_length;
 }
 
 double BusManager::CalculateAndSetCurvature(const string& bus_num){
-    if(bus_data_.count(bus_num) == 0){
+    RoutePattern* pattern = FindPattern(bus_num);
+    if(!pattern){
         return 0.0;
     }
-    auto& bus_info = bus_data_.at(bus_num);
-    if(bus_info.curvature == 0.0){
-        bus_info.curvature = bus_info.road_length / bus_info.geographical_length;
+    if(pattern->curvature == 0.0){
+        pattern->curvature = pattern->road_length / pattern->geographical_length;
     }
-    return bus_info.curvature;
+    return pattern->curvature;
 }
 
 double BusManager::CalculateAndSetUniqueStopCount(const string& bus_num){
-    if(bus_data_.count(bus_num) == 0){
+    RoutePattern* pattern = FindPattern(bus_num);
+    if(!pattern){
         return 0.0;
     }
-    auto& bus_info = bus_data_.at(bus_num);
-    if(bus_info.unique_stops == 0.0){
-        unordered_set<string> unique_stops(bus_info.stops_sequence.begin(),bus_info.stops_sequence.end());
-        bus_info.unique_stops = unique_stops.size();
-    }
-    return bus_info.unique_stops;
+    CalculateUniqueStopCount(*pattern);
+    return pattern->unique_stops;
 }
 
 double BusManager::CalculateAndSetStopCount(const string& bus_num){
-    if(bus_data_.count(bus_num) == 0){
+    RoutePattern* pattern = FindPattern(bus_num);
+    if(!pattern){
         return 0.0;
     }
-    auto& bus_info = bus_data_.at(bus_num);
-    bus_info.cnt_stops = bus_info.stops_sequence.size();
-    return bus_info.cnt_stops;
+    pattern->cnt_stops = pattern->GetStopCount();
+    return pattern->cnt_stops;
 }
 
 BusManager::RouteSettings BusManager::GetRouteSettings() const{
     return route_settings_;
 }
 
+const BusManager::RoutePattern& BusManager::GetPattern(size_t pattern_id) const{
+    return patterns_[pattern_id];
+}
+
+size_t BusManager::GetPatternCount() const{
+    return patterns_.size();
+}
+
 int BusManager::GetCountStops(const std::string& bus_num) const {
-    if(bus_data_.count(bus_num) == 0){
-        return 0;
-    }
-    return bus_data_.at(bus_num).cnt_stops;
+    const RoutePattern* pattern = FindPattern(bus_num);
+    return pattern ? pattern->cnt_stops : 0;
 }
 
 int BusManager::GetCountUniqueStops(const std::string& bus_num) const{
-    if(bus_data_.count(bus_num) == 0){
-        return 0;
-    }
-    return bus_data_.at(bus_num).unique_stops;
+    const RoutePattern* pattern = FindPattern(bus_num);
+    return pattern ? pattern->unique_stops : 0;
 }
 
 double BusManager::GetRouteLength(const std::string& bus_num) const{
-    if(bus_data_.count(bus_num) == 0){
-        return 0.0;
-    }
-    auto& bus_info = bus_data_.at(bus_num);
-    return bus_info.road_length;
+    const RoutePattern* pattern = FindPattern(bus_num);
+    return pattern ? pattern->road_length : 0.0;
 }
 
 double BusManager::GetCurvature(const std::string& bus_num) const{
-    if(bus_data_.count(bus_num) == 0){
-        return 0.0;
-    }
-    auto& bus_info = bus_data_.at(bus_num);
-    return bus_info.curvature;
+    const RoutePattern* pattern = FindPattern(bus_num);
+    return pattern ? pattern->curvature : 0.0;
 }
 
 bool BusManager::HasBus(const std::string& bus_num) const{
     return bus_data_.count(bus_num);
-}
\ No newline at end of file
+}
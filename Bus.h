@@ -1,33 +1,54 @@
 #pragma once
 #include "StopsBase.h"
 #include "json.h"
+#include <map>
 #include <memory>
 #include <tuple>
 #include <unordered_set>
 #include <unordered_map>
 #include <string_view>
 #include <string>
+#include <utility>
 #include <vector>
 #include <cmath>
 
 class BusManager{
 public:
     BusManager(std::shared_ptr<StopManager> stops_base) : stop_base_ptr_(stops_base){}
+    // A bus as listed in its request
     struct BusInfo{
-        std::vector<std::string> stops_sequence;
+        std::vector<std::string> stops;
+        bool is_round_trip = false;
+    };
+
+    // Stop sequence shared by every bus that runs it, together with its stats.
+    // A non-roundtrip route keeps only the forward stops and is walked back from the last one.
+    struct RoutePattern{
+        std::vector<size_t> stop_ids;
+        bool is_round_trip = false;
         int cnt_stops = 0;
         int unique_stops = 0;
         double geographical_length = 0.0;
         double road_length = 0.0;
         double curvature = 0.0;
-        bool is_round_trip = false;
+
+        size_t GetStopCount() const{
+            return is_round_trip || stop_ids.size() < 2 ? stop_ids.size() : 2 * stop_ids.size() - 1;
+        }
+        size_t GetStopId(size_t idx) const{
+            return idx < stop_ids.size() ? stop_ids[idx] : stop_ids[2 * stop_ids.size() - 2 - idx];
+        }
     };
 
     struct RouteSettings{
         double bus_wait_time = 0;
         double bus_velocity = 0;
+        bool operator == (const RouteSettings& other) const{
+            return bus_wait_time == other.bus_wait_time && bus_velocity == other.bus_velocity;
+        }
     };
 
+    // Iterates (bus name, pattern id) pairs
     auto begin() const{
         return bus_data_.begin();
     }
@@ -36,12 +57,20 @@ public:
         return bus_data_.end();
     }
 
+    auto FindBus(const std::string& bus_num) const{
+        return bus_data_.find(bus_num);
+    }
+
     std::tuple<std::string,BusInfo> ProcessBusRequest(const std::map<std::string,Json::Node>& request);
     void AddBus(const std::string& bus_num,const BusInfo& bus);
     void AddBusToStop(const std::string& bus_num,const BusInfo& bus_stops);
     void AddBusRoutingSettings(const Json::Node& route_settings_node);
+    static RouteSettings ReadRouteSettings(const Json::Node& route_settings_node);
 
     double CalculateAndSetGeographicalLength(const std::string& bus_num);
+    void CalculateAndSetAllGeographicalLengths();
+    // Fills the stats of every pattern in one parallel pass; repeated calls are free until a bus is added.
+    void CalculateAndSetAllBusParams();
     double CalculateAndSetRoadLength(const std::string& bus_num);
     double CalculateAndSetCurvature(const std::string& bus_num);
     double CalculateAndSetUniqueStopCount(const std::string& bus_num);
@@ -53,12 +82,27 @@ public:
     double GetCurvature(const std::string& bus_num) const;
     RouteSettings GetRouteSettings() const;
 
+    const RoutePattern& GetPattern(size_t pattern_id) const;
+    size_t GetPatternCount() const;
+
     bool HasBus(const std::string& bus_num) const;
 private:
 
     BusInfo ProcessStops(const std::map<std::string,Json::Node>& request);
+    size_t InternPattern(std::vector<size_t> stop_ids,bool is_round_trip);
+    RoutePattern* FindPattern(const std::string& bus_num);
+    const RoutePattern* FindPattern(const std::string& bus_num) const;
+    void AppendSegmentStopIds(const RoutePattern& pattern,std::vector<size_t>& from_ids,std::vector<size_t>& to_ids) const;
+    void CalculateGeographicalLengths(const std::vector<RoutePattern*>& patterns) const;
+    void CalculateRoadLength(RoutePattern& pattern) const;
+    static void CalculateUniqueStopCount(RoutePattern& pattern);
+    void CalculateBusParams(RoutePattern& pattern) const;
 
-    std::unordered_map<std::string, BusInfo> bus_data_;
+    std::unordered_map<std::string, size_t> bus_data_;
+    std::vector<RoutePattern> patterns_;
+    // hash of (stop ids, roundtrip flag) -> pattern id
+    std::unordered_multimap<size_t, size_t> pattern_ids_;
     std::shared_ptr<StopManager> stop_base_ptr_;
     RouteSettings route_settings_;
+    bool all_bus_params_ready_ = false;
 };
@@ -0,0 +1,112 @@
+#include "CityGenerator.h"
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string StopName(size_t idx){
+    return "Stop " + to_string(idx);
+}
+
+string BusName(size_t idx){
+    return "Bus " + to_string(idx);
+}
+
+}
+
+string GenerateCity(const CityParams& params){
+    mt19937_64 random(params.seed);
+    uniform_real_distribution<double> latitude(55.5,55.9);
+    uniform_real_distribution<double> longitude(37.3,37.9);
+    uniform_real_distribution<double> unit(0.0,1.0);
+    uniform_int_distribution<int> distance(200,4000);
+    const size_t stop_count = max<size_t>(params.stop_count,2);
+    uniform_int_distribution<size_t> any_stop(0,stop_count - 1);
+
+    vector<map<size_t,int>> road_distances(stop_count);
+    vector<vector<size_t>> routes(params.bus_count);
+    vector<bool> roundtrip(params.bus_count);
+    for(size_t bus = 0; bus < params.bus_count; bus++){
+        auto& route = routes[bus];
+        const size_t length = max<size_t>(params.route_length,2);
+        route.push_back(any_stop(random));
+        while(route.size() < length){
+            size_t next = any_stop(random);
+            if(next != route.back()){
+                route.push_back(next);
+            }
+        }
+        roundtrip[bus] = unit(random) < params.roundtrip_ratio;
+        if(roundtrip[bus]){
+            route.push_back(route.front());
+        }
+        for(size_t idx = 1; idx < route.size(); idx++){
+            road_distances[route[idx-1]].emplace(route[idx],distance(random));
+            if(!roundtrip[bus]){
+                road_distances[route[idx]].emplace(route[idx-1],distance(random));
+            }
+        }
+    }
+    for(size_t stop = 0; stop < stop_count; stop++){
+        double extra = params.distance_density;
+        for(; extra >= 1.0 || (extra > 0 && unit(random) < extra); extra -= 1.0){
+            const size_t to = any_stop(random);
+            if(to != stop){
+                road_distances[stop].emplace(to,distance(random));
+            }
+        }
+    }
+
+    ostringstream out;
+    out << setprecision(9);
+    out << "{\"routing_settings\": {\"bus_wait_time\": " << params.bus_wait_time
+        << ", \"bus_velocity\": " << params.bus_velocity << "},\n\"base_requests\": [\n";
+    for(size_t stop = 0; stop < stop_count; stop++){
+        out << "{\"type\": \"Stop\", \"name\": \"" << StopName(stop) << "\", \"latitude\": " << latitude(random)
+            << ", \"longitude\": " << longitude(random) << ", \"road_distances\": {";
+        bool first = true;
+        for(const auto& [to,meters] : road_distances[stop]){
+            out << (first ? "" : ", ") << '"' << StopName(to) << "\": " << meters;
+            first = false;
+        }
+        out << "}},\n";
+    }
+    for(size_t bus = 0; bus < params.bus_count; bus++){
+        out << "{\"type\": \"Bus\", \"name\": \"" << BusName(bus) << "\", \"stops\": [";
+        for(size_t idx = 0; idx < routes[bus].size(); idx++){
+            out << (idx ? ", " : "") << '"' << StopName(routes[bus][idx]) << '"';
+        }
+        out << "], \"is_roundtrip\": " << (roundtrip[bus] ? "true" : "false") << "}"
+            << (bus + 1 < params.bus_count ? ",\n" : "\n");
+    }
+    out << "],\n\"stat_requests\": [\n";
+
+    const size_t request_count = params.stop_requests + params.bus_requests + params.route_requests;
+    vector<int> kinds;
+    kinds.insert(kinds.end(),params.stop_requests,0);
+    kinds.insert(kinds.end(),params.bus_requests,1);
+    kinds.insert(kinds.end(),params.route_requests,2);
+    shuffle(kinds.begin(),kinds.end(),random);
+    uniform_int_distribution<size_t> any_bus(0,max<size_t>(params.bus_count,1) - 1);
+    for(size_t id = 0; id < request_count; id++){
+        if(kinds[id] == 0){
+            out << "{\"type\": \"Stop\", \"name\": \"" << StopName(any_stop(random)) << '"';
+        }
+        else if(kinds[id] == 1){
+            out << "{\"type\": \"Bus\", \"name\": \"" << BusName(any_bus(random)) << '"';
+        }
+        else{
+            out << "{\"type\": \"Route\", \"from\": \"" << StopName(any_stop(random))
+                << "\", \"to\": \"" << StopName(any_stop(random)) << '"';
+        }
+        out << ", \"id\": " << id << "}" << (id + 1 < request_count ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return out.str();
+}
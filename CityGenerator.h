@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct CityParams{
+    uint64_t seed = 1;
+    size_t stop_count = 100;
+    size_t bus_count = 20;
+    size_t route_length = 10;
+    double roundtrip_ratio = 0.5;
+    // extra road_distances per stop besides the ones required by bus routes
+    double distance_density = 1.0;
+    size_t stop_requests = 0;
+    size_t bus_requests = 0;
+    size_t route_requests = 0;
+    double bus_wait_time = 6;
+    double bus_velocity = 40;
+};
+
+// Builds a synthetic input document in the format read by ProcessInput.
+std::string GenerateCity(const CityParams& params);
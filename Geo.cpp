@@ -0,0 +1,90 @@
+#include "Geo.h"
+#include "StopsBase.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Batch size keeps the gathered operands in L1 while the kernel runs.
+const size_t Geo_Batch_Size = 256;
+
+struct GatheredBatch{
+    alignas(32) double sin_lat1[Geo_Batch_Size];
+    alignas(32) double cos_lat1[Geo_Batch_Size];
+    alignas(32) double sin_lat2[Geo_Batch_Size];
+    alignas(32) double cos_lat2[Geo_Batch_Size];
+    alignas(32) double cos_dlon[Geo_Batch_Size];
+    alignas(32) double cos_angle[Geo_Batch_Size];
+};
+
+// Spherical law of cosines, with the operations in the same order as the scalar formula
+// sin1 * sin2 + cos1 * cos2 * cos(|lon1 - lon2|), so every lane gives the same bits.
+void ComputeCosAngles(GatheredBatch& batch,size_t count){
+    size_t idx = 0;
+#if defined(__AVX__)
+    for(; idx + 4 <= count; idx += 4){
+        const __m256d result = _mm256_add_pd(
+            _mm256_mul_pd(_mm256_load_pd(batch.sin_lat1 + idx),_mm256_load_pd(batch.sin_lat2 + idx)),
+            _mm256_mul_pd(_mm256_mul_pd(_mm256_load_pd(batch.cos_lat1 + idx),_mm256_load_pd(batch.cos_lat2 + idx)),
+                _mm256_load_pd(batch.cos_dlon + idx)));
+        _mm256_store_pd(batch.cos_angle + idx,result);
+    }
+#elif defined(__SSE2__)
+    for(; idx + 2 <= count; idx += 2){
+        const __m128d result = _mm_add_pd(
+            _mm_mul_pd(_mm_load_pd(batch.sin_lat1 + idx),_mm_load_pd(batch.sin_lat2 + idx)),
+            _mm_mul_pd(_mm_mul_pd(_mm_load_pd(batch.cos_lat1 + idx),_mm_load_pd(batch.cos_lat2 + idx)),
+                _mm_load_pd(batch.cos_dlon + idx)));
+        _mm_store_pd(batch.cos_angle + idx,result);
+    }
+#endif
+    for(; idx < count; idx++){
+        batch.cos_angle[idx] = batch.sin_lat1[idx] * batch.sin_lat2[idx] + batch.cos_lat1[idx] * batch.cos_lat2[idx] * batch.cos_dlon[idx];
+    }
+}
+
+}
+
+void CoordinatesStore::Set(size_t stop_id,double latitude,double longitude){
+    if(stop_id >= latitude_.size()){
+        const size_t new_size = stop_id + 1;
+        latitude_.resize(new_size,0.0);
+        longitude_.resize(new_size,0.0);
+        sin_latitude_.resize(new_size,0.0);
+        cos_latitude_.resize(new_size,1.0);
+    }
+    latitude_[stop_id] = latitude;
+    longitude_[stop_id] = longitude;
+    sin_latitude_[stop_id] = sin(latitude);
+    cos_latitude_[stop_id] = cos(latitude);
+}
+
+size_t CoordinatesStore::size() const{
+    return latitude_.size();
+}
+
+void ComputeGreatCircleDistances(const CoordinatesStore& store,const size_t* from_ids,
+    const size_t* to_ids,size_t count,double* result){
+    GatheredBatch batch;
+    for(size_t offset = 0; offset < count; offset += Geo_Batch_Size){
+        const size_t batch_size = min(Geo_Batch_Size,count - offset);
+        for(size_t idx = 0; idx < batch_size; idx++){
+            const size_t from = from_ids[offset + idx];
+            const size_t to = to_ids[offset + idx];
+            batch.sin_lat1[idx] = store.sin_latitude_[from];
+            batch.cos_lat1[idx] = store.cos_latitude_[from];
+            batch.sin_lat2[idx] = store.sin_latitude_[to];
+            batch.cos_lat2[idx] = store.cos_latitude_[to];
+            batch.cos_dlon[idx] = cos(abs(store.longitude_[from] - store.longitude_[to]));
+        }
+        ComputeCosAngles(batch,batch_size);
+        for(size_t idx = 0; idx < batch_size; idx++){
+            result[offset + idx] = acos(min(1.0,max(-1.0,batch.cos_angle[idx]))) * Earth_Radius;
+        }
+    }
+}
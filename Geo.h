@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays store of stop coordinates (in radians) indexed by stop id,
+// with latitude trigonometry precomputed once per stop.
+class CoordinatesStore{
+public:
+    void Set(size_t stop_id,double latitude,double longitude);
+    size_t size() const;
+
+    const double* Latitudes() const { return latitude_.data(); }
+    const double* Longitudes() const { return longitude_.data(); }
+
+    friend void ComputeGreatCircleDistances(const CoordinatesStore& store,const size_t* from_ids,
+        const size_t* to_ids,size_t count,double* result);
+private:
+    std::vector<double> latitude_;
+    std::vector<double> longitude_;
+    std::vector<double> sin_latitude_;
+    std::vector<double> cos_latitude_;
+};
+
+void ComputeGreatCircleDistances(const CoordinatesStore& store,const size_t* from_ids,
+    const size_t* to_ids,size_t count,double* result);
@@ -1,5 +1,9 @@
 #include "json.h"
 
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
 using namespace std;
 
 namespace Json {
@@ -83,4 +87,205 @@ namespace Json {
     return Document{LoadNode(input)};
   }
 
+  void PrintString(ostream& output, string_view text) {
+    static const char Hex_Digits[] = "0123456789abcdef";
+    output << '"';
+    for (const char c : text) {
+      switch (c) {
+      case '"':
+        output << "\\\"";
+        break;
+      case '\\':
+        output << "\\\\";
+        break;
+      case '\n':
+        output << "\\n";
+        break;
+      case '\r':
+        output << "\\r";
+        break;
+      case '\t':
+        output << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          output << "\\u00" << Hex_Digits[c >> 4] << Hex_Digits[c & 0xF];
+        } else {
+          output << c;
+        }
+      }
+    }
+    output << '"';
+  }
+
+  size_t SkipSpaces(string_view text, size_t pos) {
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) {
+      ++pos;
+    }
+    return pos;
+  }
+
+  // The grammar of the stream loader above, read in place from a string_view
+  class TextLoader {
+  public:
+    explicit TextLoader(string_view text) : text(text) {
+    }
+
+    Node LoadNode() {
+      const char c = NextChar();
+      if (c == '\0') {
+        throw invalid_argument("json: unexpected end of input at offset " + to_string(pos));
+      } else if (c == '[') {
+        return LoadArray();
+      } else if (c == '{') {
+        return LoadDict();
+      } else if (c == '"') {
+        return LoadString();
+      } else {
+        --pos;
+        return LoadDouble();
+      }
+    }
+
+  private:
+    string_view text;
+    size_t pos = 0;
+
+    // Next non-space character, or '\0' at the end of the text
+    char NextChar() {
+      pos = SkipSpaces(text, pos);
+      return pos < text.size() ? text[pos++] : '\0';
+    }
+
+    char Peek() const {
+      return pos < text.size() ? text[pos] : '\0';
+    }
+
+    Node LoadArray() {
+      vector<Node> result;
+      for (char c; (c = NextChar()) != '\0' && c != ']'; ) {
+        if (c != ',') {
+          --pos;
+        }
+        result.push_back(LoadNode());
+      }
+      return Node(move(result));
+    }
+
+    Node LoadDouble() {
+      if (Peek() == 't') {
+        pos = min(text.size(), pos + 4);
+        return Node(true);
+      } else if (Peek() == 'f') {
+        pos = min(text.size(), pos + 5);
+        return Node(false);
+      }
+      const size_t begin = pos;
+      while (Peek() == '-' || Peek() == '.' || isdigit(static_cast<unsigned char>(Peek()))) {
+        ++pos;
+      }
+      if (pos == begin) {
+        throw invalid_argument("json: unexpected character at offset " + to_string(pos));
+      }
+      return Node(stod(string(text.substr(begin, pos - begin))));
+    }
+
+    Node LoadString() {
+      const size_t end = min(text.find('"', pos), text.size());
+      string line(text.substr(pos, end - pos));
+      pos = min(text.size(), end + 1);
+      return Node(move(line));
+    }
+
+    Node LoadDict() {
+      map<string, Node> result;
+      for (char c; (c = NextChar()) != '\0' && c != '}'; ) {
+        if (c == ',') {
+          NextChar();
+        }
+        string key = LoadString().AsString();
+        NextChar();
+        result.emplace(move(key), LoadNode());
+      }
+      return Node(move(result));
+    }
+  };
+
+  Node LoadNode(string_view text) {
+    return TextLoader(text).LoadNode();
+  }
+
+  size_t SkipString(string_view text, size_t pos) {
+    for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+      if (text[pos] == '\\') {
+        ++pos;
+      }
+    }
+    return pos + 1;
+  }
+
+  size_t SkipValue(string_view text, size_t pos) {
+    if (text[pos] == '"') {
+      return SkipString(text, pos);
+    }
+    int depth = 0;
+    for (; pos < text.size(); ++pos) {
+      const char c = text[pos];
+      if (c == '"') {
+        pos = SkipString(text, pos) - 1;
+      } else if (c == '[' || c == '{') {
+        ++depth;
+      } else if (c == ']' || c == '}') {
+        if (depth == 0) {
+          return pos;
+        }
+        if (--depth == 0) {
+          return pos + 1;
+        }
+      } else if (c == ',' && depth == 0) {
+        return pos;
+      }
+    }
+    return pos;
+  }
+
+  vector<pair<string, string_view>> ScanObjectMembers(string_view text) {
+    vector<pair<string, string_view>> result;
+    size_t pos = SkipSpaces(text, 0);
+    if (pos == text.size() || text[pos] != '{') {
+      return result;
+    }
+    for (pos = SkipSpaces(text, pos + 1); pos < text.size() && text[pos] != '}'; pos = SkipSpaces(text, pos)) {
+      if (text[pos] == ',') {
+        pos = SkipSpaces(text, pos + 1);
+      }
+      const size_t key_end = SkipString(text, pos);
+      string key(text.substr(pos + 1, key_end - pos - 2));
+      pos = SkipSpaces(text, key_end);
+      pos = SkipSpaces(text, pos + 1);
+      const size_t value_end = SkipValue(text, pos);
+      result.emplace_back(move(key), text.substr(pos, value_end - pos));
+      pos = value_end;
+    }
+    return result;
+  }
+
+  vector<string_view> ScanArrayElements(string_view text) {
+    vector<string_view> result;
+    size_t pos = SkipSpaces(text, 0);
+    if (pos == text.size() || text[pos] != '[') {
+      return result;
+    }
+    for (pos = SkipSpaces(text, pos + 1); pos < text.size() && text[pos] != ']'; pos = SkipSpaces(text, pos)) {
+      if (text[pos] == ',') {
+        pos = SkipSpaces(text, pos + 1);
+        continue;
+      }
+      const size_t value_end = SkipValue(text, pos);
+      result.push_back(text.substr(pos, value_end - pos));
+      pos = value_end;
+    }
+    return result;
+  }
+
 }
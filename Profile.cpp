@@ -0,0 +1,281 @@
+#include "Profile.h"
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace Profile {
+
+namespace {
+
+atomic<bool> enabled{false};
+atomic<uint64_t> allocation_count{0};
+atomic<uint64_t> allocation_bytes{0};
+atomic<AllocationHook> allocation_hook{nullptr};
+atomic<uint64_t> slow_route_threshold_ns{0};
+atomic<ostream*> slow_route_log{&cerr};
+mutex slow_route_log_lock;
+
+// Threads inside at least one phase, and how many times a thread entered its outermost phase
+atomic<size_t> threads_in_phase{0};
+atomic<uint64_t> phase_thread_starts{0};
+thread_local size_t phase_depth = 0;
+
+const size_t Request_Kind_Count = 3;
+const char* const Request_Kind_Names[Request_Kind_Count] = {"Stop","Bus","Route"};
+
+struct ThreadHistograms{
+    LatencyHistogram histograms[Request_Kind_Count];
+};
+
+struct HistogramRegistry{
+    mutex lock;
+    vector<shared_ptr<ThreadHistograms>> threads;
+};
+
+HistogramRegistry& GetHistogramRegistry(){
+    static HistogramRegistry registry;
+    return registry;
+}
+
+ThreadHistograms& GetThreadHistograms(){
+    thread_local shared_ptr<ThreadHistograms> histograms = []{
+        auto result = make_shared<ThreadHistograms>();
+        auto& registry = GetHistogramRegistry();
+        lock_guard guard(registry.lock);
+        registry.threads.push_back(result);
+        return result;
+    }();
+    return *histograms;
+}
+
+struct PhaseRecord{
+    string name;
+    double wall_ms;
+    double cpu_ms;
+    AllocationStats allocations;
+    bool overlapped;
+};
+
+struct Report{
+    mutex lock;
+    vector<PhaseRecord> phases;
+    map<string,uint64_t> counters;
+};
+
+Report& GetReport(){
+    static Report report;
+    return report;
+}
+
+}
+
+void Enable(bool value){
+    enabled.store(value,memory_order_relaxed);
+}
+
+bool IsEnabled(){
+    return enabled.load(memory_order_relaxed);
+}
+
+void RecordAllocation(size_t size){
+    if(enabled.load(memory_order_relaxed)){
+        allocation_count.fetch_add(1,memory_order_relaxed);
+        allocation_bytes.fetch_add(size,memory_order_relaxed);
+        if(auto hook = allocation_hook.load(memory_order_relaxed)){
+            hook(size);
+        }
+    }
+}
+
+AllocationStats GetAllocationStats(){
+    return {allocation_count.load(memory_order_relaxed),allocation_bytes.load(memory_order_relaxed)};
+}
+
+void SetAllocationHook(AllocationHook hook){
+    allocation_hook.store(hook,memory_order_relaxed);
+}
+
+void LatencyHistogram::Record(uint64_t value){
+    auto& count = counts_[GetBucketIndex(value)];
+    count.store(count.load(memory_order_relaxed) + 1,memory_order_relaxed);
+}
+
+void LatencyHistogram::AddTo(vector<uint64_t>& counts) const{
+    counts.resize(Bucket_Count,0);
+    for(size_t idx = 0; idx < Bucket_Count; idx++){
+        counts[idx] += counts_[idx].load(memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value){
+    if(value < Sub_Bucket_Count){
+        return value;
+    }
+    size_t top_bit = 63;
+    while(!(value >> top_bit)){
+        top_bit--;
+    }
+    const size_t shift = top_bit - Sub_Bucket_Bits;
+    return (shift + 1) * Sub_Bucket_Count + ((value >> shift) - Sub_Bucket_Count);
+}
+
+uint64_t LatencyHistogram::GetBucketValue(size_t index){
+    const size_t bucket = index / Sub_Bucket_Count;
+    const uint64_t sub_bucket = index % Sub_Bucket_Count;
+    if(bucket == 0){
+        return sub_bucket;
+    }
+    return (Sub_Bucket_Count + sub_bucket) << (bucket - 1);
+}
+
+uint64_t LatencyHistogram::GetPercentile(const vector<uint64_t>& counts, double quantile){
+    uint64_t total = 0;
+    for(uint64_t count : counts){
+        total += count;
+    }
+    if(total == 0){
+        return 0;
+    }
+    const uint64_t rank = min<uint64_t>(total - 1,static_cast<uint64_t>(quantile * total));
+    uint64_t seen = 0;
+    for(size_t idx = 0; idx < counts.size(); idx++){
+        seen += counts[idx];
+        if(seen > rank){
+            return GetBucketValue(idx);
+        }
+    }
+    return GetBucketValue(counts.size() - 1);
+}
+
+bool IsLatencyTrackingEnabled(){
+    return IsEnabled() || slow_route_threshold_ns.load(memory_order_relaxed) != 0;
+}
+
+void RecordLatency(RequestKind kind, uint64_t nanoseconds){
+    GetThreadHistograms().histograms[static_cast<size_t>(kind)].Record(nanoseconds);
+}
+
+vector<uint64_t> GetLatencyCounts(RequestKind kind){
+    vector<uint64_t> counts(LatencyHistogram::Bucket_Count,0);
+    auto& registry = GetHistogramRegistry();
+    lock_guard guard(registry.lock);
+    for(const auto& thread : registry.threads){
+        thread->histograms[static_cast<size_t>(kind)].AddTo(counts);
+    }
+    return counts;
+}
+
+void SetSlowRouteThreshold(uint64_t nanoseconds, ostream* log){
+    slow_route_log.store(log,memory_order_relaxed);
+    slow_route_threshold_ns.store(nanoseconds,memory_order_relaxed);
+}
+
+bool IsSlowRoute(uint64_t nanoseconds){
+    const uint64_t threshold = slow_route_threshold_ns.load(memory_order_relaxed);
+    return threshold != 0 && nanoseconds >= threshold;
+}
+
+void LogSlowRoute(const SlowRouteQuery& query){
+    ostream* log = slow_route_log.load(memory_order_relaxed);
+    if(!log){
+        return;
+    }
+    lock_guard guard(slow_route_log_lock);
+    *log << "{\"slow_route\": {\"from\": \"" << query.from << "\", \"to\": \"" << query.to
+         << "\", \"latency_us\": " << query.latency_ns / 1000.0
+         << ", \"settled_vertices\": " << query.settled_vertices
+         << ", \"relaxed_edges\": " << query.relaxed_edges
+         << ", \"result_items\": " << query.result_items
+         << ", \"found\": " << (query.found ? "true" : "false") << "}}" << endl;
+}
+
+void SetCounter(const string& name, uint64_t value){
+    if(!IsEnabled()){
+        return;
+    }
+    auto& report = GetReport();
+    lock_guard guard(report.lock);
+    report.counters[name] = value;
+}
+
+void PrintReport(ostream& out){
+    auto& report = GetReport();
+    lock_guard guard(report.lock);
+    out << fixed << setprecision(3);
+    out << left << setw(20) << "phase" << right << setw(12) << "wall_ms" << setw(12) << "cpu_ms"
+        << setw(12) << "allocs" << setw(16) << "alloc_bytes" << endl;
+    bool has_overlapped = false;
+    for(const auto& phase : report.phases){
+        has_overlapped = has_overlapped || phase.overlapped;
+        out << left << setw(20) << (phase.overlapped ? phase.name + '*' : phase.name) << right << setw(12) << phase.wall_ms << setw(12) << phase.cpu_ms
+            << setw(12) << phase.allocations.count << setw(16) << phase.allocations.bytes << endl;
+    }
+    out << "cpu_ms and allocations are process-wide";
+    if(has_overlapped){
+        out << "; * ran alongside phases on other threads and includes their work";
+    }
+    out << endl;
+    for(const auto& [name,value] : report.counters){
+        out << name << ": " << value << endl;
+    }
+    for(size_t kind = 0; kind < Request_Kind_Count; kind++){
+        const auto counts = GetLatencyCounts(static_cast<RequestKind>(kind));
+        uint64_t total = 0;
+        for(uint64_t count : counts){
+            total += count;
+        }
+        if(total == 0){
+            continue;
+        }
+        out << "latency_us." << Request_Kind_Names[kind] << ": count " << total;
+        const pair<const char*,double> percentiles[] = {{"p50",0.5},{"p90",0.9},{"p99",0.99},{"p99.9",0.999},{"max",1.0}};
+        for(const auto& [name,quantile] : percentiles){
+            out << ' ' << name << ' ' << LatencyHistogram::GetPercentile(counts,quantile) / 1000.0;
+        }
+        out << endl;
+    }
+    out << defaultfloat;
+}
+
+PhaseTimer::PhaseTimer(string name) : name_(move(name)), active_(IsEnabled()){
+    if(active_){
+        if(phase_depth++ == 0){
+            threads_in_phase.fetch_add(1,memory_order_relaxed);
+            phase_thread_starts.fetch_add(1,memory_order_relaxed);
+        }
+        thread_starts_ = phase_thread_starts.load(memory_order_relaxed);
+        overlapped_ = threads_in_phase.load(memory_order_relaxed) > 1;
+        wall_start_ = chrono::steady_clock::now();
+        cpu_start_ = clock();
+        allocations_start_ = GetAllocationStats();
+    }
+}
+
+PhaseTimer::~PhaseTimer(){
+    if(!active_){
+        return;
+    }
+    const auto allocations = GetAllocationStats();
+    overlapped_ = overlapped_ || threads_in_phase.load(memory_order_relaxed) > 1
+        || phase_thread_starts.load(memory_order_relaxed) != thread_starts_;
+    if(--phase_depth == 0){
+        threads_in_phase.fetch_sub(1,memory_order_relaxed);
+    }
+    PhaseRecord record{
+        move(name_),
+        chrono::duration<double,milli>(chrono::steady_clock::now() - wall_start_).count(),
+        1000.0 * (clock() - cpu_start_) / CLOCKS_PER_SEC,
+        {allocations.count - allocations_start_.count,allocations.bytes - allocations_start_.bytes},
+        overlapped_
+    };
+    auto& report = GetReport();
+    lock_guard guard(report.lock);
+    report.phases.push_back(move(record));
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Phase timers, counters and allocation accounting for --stats.
+// Everything is a no-op (one relaxed load) until Profile::Enable is called.
+// CPU time and allocations are process-wide: a phase is charged for its worker threads, and also
+// for anything other threads did meanwhile; such phases are marked as overlapped in the report.
+namespace Profile {
+
+    void Enable(bool enabled = true);
+    bool IsEnabled();
+
+    struct AllocationStats{
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+    AllocationStats GetAllocationStats();
+    // Called by the global operator new replacements (Allocation.cpp)
+    void RecordAllocation(size_t size);
+
+    // Called for every allocation while profiling is enabled, in addition to the built-in counters.
+    using AllocationHook = void (*)(size_t size);
+    void SetAllocationHook(AllocationHook hook);
+
+    void SetCounter(const std::string& name, uint64_t value);
+    void PrintReport(std::ostream& out = std::cerr);
+
+    // Log-linear (HDR-style) histogram of nanosecond latencies with ~3% relative precision.
+    // Each instance has a single writer; readers may merge it concurrently.
+    class LatencyHistogram{
+    public:
+        static constexpr size_t Sub_Bucket_Bits = 5;
+        static constexpr size_t Sub_Bucket_Count = size_t{1} << Sub_Bucket_Bits;
+        static constexpr size_t Bucket_Count = (64 - Sub_Bucket_Bits + 1) * Sub_Bucket_Count;
+
+        void Record(uint64_t value);
+        void AddTo(std::vector<uint64_t>& counts) const;
+
+        static size_t GetBucketIndex(uint64_t value);
+        static uint64_t GetBucketValue(size_t index);
+        static uint64_t GetPercentile(const std::vector<uint64_t>& counts, double quantile);
+    private:
+        std::array<std::atomic<uint64_t>,Bucket_Count> counts_{};
+    };
+
+    enum class RequestKind{
+        Stop,
+        Bus,
+        Route
+    };
+
+    // Per-request latencies are tracked while profiling is on or a slow-route threshold is set.
+    bool IsLatencyTrackingEnabled();
+    void RecordLatency(RequestKind kind, uint64_t nanoseconds);
+    std::vector<uint64_t> GetLatencyCounts(RequestKind kind);
+
+    struct SlowRouteQuery{
+        std::string from;
+        std::string to;
+        uint64_t latency_ns = 0;
+        size_t settled_vertices = 0;
+        size_t relaxed_edges = 0;
+        size_t result_items = 0;
+        bool found = false;
+    };
+
+    void SetSlowRouteThreshold(uint64_t nanoseconds, std::ostream* log = &std::cerr);
+    bool IsSlowRoute(uint64_t nanoseconds);
+    void LogSlowRoute(const SlowRouteQuery& query);
+
+    class PhaseTimer{
+    public:
+        explicit PhaseTimer(std::string name);
+        ~PhaseTimer();
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+    private:
+        std::string name_;
+        bool active_;
+        bool overlapped_ = false;
+        uint64_t thread_starts_ = 0;
+        std::chrono::steady_clock::time_point wall_start_;
+        std::clock_t cpu_start_ = 0;
+        AllocationStats allocations_start_;
+    };
+
+}
@@ -0,0 +1,497 @@
+#include "Requests.h"
+#include "Profile.h"
+#include <chrono>
+#include <algorithm>
+#include <future>
+#include <iterator>
+#include <optional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+void PrintBusResultImpl(const StatsRequest& stat,
+    shared_ptr<BusManager> bus_base, ostream& out){
+    if(!bus_base->HasBus(stat.name)){
+        out << "   " << '"' << "request_id" << '"' << ": " << stat.request_id << "," << endl;
+        out << "   " << '"' << "error_message" << '"' << ": " << '"' << "not found" << '"' << endl;
+    }
+    else{
+        out << "   "  << '"' << "route_length" << '"' << ": " << bus_base->GetRouteLength(stat.name) << "," << endl;
+        out << "   "  << '"' << "request_id" << '"' << ": " << stat.request_id << ","<< endl; 
+        out << "   "  << '"' << "curvature" << '"' << ": " << bus_base->GetCurvature(stat.name) << "," << endl;
+        out << "   "  << '"' << "stop_count" << '"' << ": " << bus_base->GetCountStops(stat.name) << "," << endl;
+        out << "   "  << '"' << "unique_stop_count" << '"' << ": " << bus_base->GetCountUniqueStops(stat.name) << endl;
+    }
+}
+
+void PrintStopResultImpl(const StatsRequest& stat, shared_ptr<StopManager> stops_base, ostream& out) {
+    if (!stops_base->HasStop(stat.name)) {
+        out << "   " << '"' << "request_id" << '"' << ": " << stat.request_id << "," << endl;
+        out << "   " << '"' << "error_message" << '"' << ": " << '"' << "not found" << '"' << endl;
+    } else {
+        out << "   " << '"' << "buses" << '"' << ": [";
+        if (stops_base->HasBusesOnStop(stat.name)) {
+            out << stops_base->GetStopInfo(stat.name);
+        }
+        out << "]," << endl; 
+        out << "   " << '"' << "request_id" << '"' << ": " << stat.request_id << endl;
+    }
+}
+
+optional<size_t> PrintRouteResultImpl(const StatsRequest& stat, const TransportSystem& transport_system, ostream& out,
+    Graph::SearchStats* search_stats) {
+    auto route = stat.routing_settings
+        ? transport_system.FindRenderedRoute(stat.from, stat.to, *stat.routing_settings, search_stats)
+        : transport_system.FindRenderedRoute(stat.from, stat.to, search_stats);
+    if (!route) {
+        out << "   " << '"' << "request_id" << '"' << ": " << stat.request_id << "," << endl;
+        out << "   " << '"' << "error_message" << '"' << ": " << '"' << "not found" << '"' << endl;
+        return nullopt;
+    }
+    out << "   " << '"' << "items" << '"' << ": [" << endl;
+    out << route->items;
+    out << "   " << "]," << endl;
+    out << "   " << '"' << "total_time" << '"' << ": " << route->total_time << "," << endl;
+    out << "   " << '"' << "request_id" << '"' << ": " << stat.request_id << endl;
+    return route->item_count;
+}
+
+uint64_t GetElapsedNs(chrono::steady_clock::time_point start){
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+}
+
+void PrintBusResult(const StatsRequest& stat,
+    shared_ptr<BusManager> bus_base, ostream& out){
+    if(!Profile::IsLatencyTrackingEnabled()){
+        PrintBusResultImpl(stat,bus_base,out);
+        return;
+    }
+    const auto start = chrono::steady_clock::now();
+    PrintBusResultImpl(stat,bus_base,out);
+    Profile::RecordLatency(Profile::RequestKind::Bus,GetElapsedNs(start));
+}
+
+void PrintStopResult(const StatsRequest& stat, shared_ptr<StopManager> stops_base, ostream& out) {
+    if(!Profile::IsLatencyTrackingEnabled()){
+        PrintStopResultImpl(stat,stops_base,out);
+        return;
+    }
+    const auto start = chrono::steady_clock::now();
+    PrintStopResultImpl(stat,stops_base,out);
+    Profile::RecordLatency(Profile::RequestKind::Stop,GetElapsedNs(start));
+}
+
+void PrintBusResult(const StatsRequest& stat, const ResponseCache& response_cache, ostream& out){
+    if(!Profile::IsLatencyTrackingEnabled()){
+        response_cache.WriteBusResponse(stat.name,stat.request_id,out);
+        return;
+    }
+    const auto start = chrono::steady_clock::now();
+    response_cache.WriteBusResponse(stat.name,stat.request_id,out);
+    Profile::RecordLatency(Profile::RequestKind::Bus,GetElapsedNs(start));
+}
+
+void PrintStopResult(const StatsRequest& stat, const ResponseCache& response_cache, ostream& out){
+    if(!Profile::IsLatencyTrackingEnabled()){
+        response_cache.WriteStopResponse(stat.name,stat.request_id,out);
+        return;
+    }
+    const auto start = chrono::steady_clock::now();
+    response_cache.WriteStopResponse(stat.name,stat.request_id,out);
+    Profile::RecordLatency(Profile::RequestKind::Stop,GetElapsedNs(start));
+}
+
+void PrintRouteResult(const StatsRequest& stat, const TransportSystem& transport_system, ostream& out) {
+    if(!Profile::IsLatencyTrackingEnabled()){
+        PrintRouteResultImpl(stat,transport_system,out,nullptr);
+        return;
+    }
+    const auto start = chrono::steady_clock::now();
+    Graph::SearchStats search_stats;
+    const auto result_items = PrintRouteResultImpl(stat,transport_system,out,&search_stats);
+    const uint64_t latency_ns = GetElapsedNs(start);
+    Profile::RecordLatency(Profile::RequestKind::Route,latency_ns);
+    if(Profile::IsSlowRoute(latency_ns)){
+        Profile::LogSlowRoute({stat.from,stat.to,latency_ns,search_stats.settled_vertices,
+            search_stats.relaxed_edges,result_items.value_or(0),result_items.has_value()});
+    }
+}
+
+void PrintResult(const vector<StatsRequest>& stats_request,
+    shared_ptr<StopManager> stops_base, 
+    shared_ptr<BusManager> bus_base,const TransportSystem& transport_system, ostream& out){
+    out << '[' << endl;
+    for(int i = 0; i < stats_request.size(); i++){
+        out << "  {" << endl;
+        if(stats_request[i].type == "Stop"){
+            PrintStopResult(stats_request[i],stops_base,out);
+        }
+        else if(stats_request[i].type == "Bus"){
+            PrintBusResult(stats_request[i],bus_base,out);
+        }
+        else if(stats_request[i].type == "Route"){
+            PrintRouteResult(stats_request[i],transport_system,out);
+        }
+        out << "  }";
+        if(i + 1 < stats_request.size()){
+            out << ',';
+        }
+        out << endl;
+    }
+    out << ']' << endl;
+}
+
+void PrintResultPipelined(const vector<StatsRequest>& stats_request,
+    shared_ptr<StopManager> stops_base,
+    shared_ptr<BusManager> bus_base,const RoutingOptions& routing_options, ostream& out){
+    const bool has_route_requests = any_of(stats_request.begin(),stats_request.end(),[](const StatsRequest& stat){
+        return stat.type == "Route";
+    });
+    vector<string_view> stop_names;
+    vector<string_view> bus_names;
+    for(const auto& stat : stats_request){
+        if(stat.type == "Stop"){
+            stop_names.push_back(stat.name);
+        }
+        else if(stat.type == "Bus"){
+            bus_names.push_back(stat.name);
+        }
+    }
+    // Bus stats are written here, before the build thread starts reading the bus base
+    if(!bus_names.empty()){
+        bus_base->CalculateAndSetAllBusParams();
+    }
+
+    future<unique_ptr<TransportSystem>> transport_system;
+    if(has_route_requests){
+        RoutingOptions options = routing_options;
+        options.expected_route_queries = count_if(stats_request.begin(),stats_request.end(),[](const StatsRequest& stat){
+            return stat.type == "Route";
+        });
+        transport_system = async(launch::async,[bus_base,stops_base,options]{
+            return make_unique<TransportSystem>(bus_base,stops_base,options);
+        });
+    }
+
+    vector<string> responses(stats_request.size());
+    vector<bool> is_ready(stats_request.size(),false);
+    size_t printed = 0;
+    auto print_ready = [&](){
+        const size_t first = printed;
+        for(; printed < stats_request.size() && is_ready[printed]; printed++){
+            out << "  {\n" << responses[printed] << "  }";
+            if(printed + 1 < stats_request.size()){
+                out << ',';
+            }
+            out << '\n';
+            string().swap(responses[printed]);
+        }
+        if(printed != first){
+            out.flush();
+        }
+    };
+
+    out << '[' << endl;
+    optional<ResponseCache> response_cache;
+    if(!stop_names.empty() || !bus_names.empty()){
+        Profile::PhaseTimer timer("render_responses");
+        response_cache.emplace(stops_base,bus_base,stop_names,bus_names);
+        if(Profile::IsEnabled()){
+            Profile::SetCounter("responses.arena_bytes",response_cache->GetMemoryBytes());
+        }
+    }
+    ostringstream response;
+    for(size_t i = 0; i < stats_request.size(); i++){
+        if(stats_request[i].type == "Route"){
+            continue;
+        }
+        response.str({});
+        if(stats_request[i].type == "Stop"){
+            PrintStopResult(stats_request[i],*response_cache,response);
+        }
+        else if(stats_request[i].type == "Bus"){
+            PrintBusResult(stats_request[i],*response_cache,response);
+        }
+        responses[i] = response.str();
+        is_ready[i] = true;
+        print_ready();
+    }
+    if(has_route_requests){
+        const auto transport = transport_system.get();
+        for(size_t i = printed; i < stats_request.size(); i++){
+            if(stats_request[i].type == "Route"){
+                response.str({});
+                PrintRouteResult(stats_request[i],*transport,response);
+                responses[i] = response.str();
+                is_ready[i] = true;
+                print_ready();
+            }
+        }
+        transport->ReportRouteCacheStats();
+    }
+    out << ']' << endl;
+}
+
+void CalculateAndSetBusParams(shared_ptr<BusManager> bus_base, const string& bus_num){
+    bus_base->CalculateAndSetGeographicalLength(bus_num);
+    bus_base->CalculateAndSetRoadLength(bus_num);
+    bus_base->CalculateAndSetCurvature(bus_num);
+    bus_base->CalculateAndSetUniqueStopCount(bus_num);
+    bus_base->CalculateAndSetStopCount(bus_num);
+}
+
+vector<StatsRequest> ReadStatsRequests(const vector<Json::Node>& stats_request){
+    vector<StatsRequest> result;
+    for(const auto& request_node : stats_request){
+        const auto& request = request_node.AsMap();
+        if(request.at("type").AsString() == "Route"){
+            result.push_back({
+                request.at("type").AsString(),
+                {},
+                request.at("from").AsString(),
+                request.at("to").AsString(),
+                static_cast<long long>(request.at("id").AsDouble()),
+                nullopt
+            });
+            if(auto it = request.find("routing_settings"); it != request.end()){
+                result.back().routing_settings = BusManager::ReadRouteSettings(it->second);
+            }
+        }
+        else{
+            result.push_back({
+                request.at("type").AsString(),
+                request.at("name").AsString(),
+                {},
+                {},
+                static_cast<long long>(request.at("id").AsDouble()),
+                nullopt
+            });
+        }
+    }
+    return result;
+}
+
+void ProcessStatsRequest(const vector<StatsRequest>& stats_request,
+    shared_ptr<StopManager> stops_base,
+    shared_ptr<BusManager> bus_base){
+        const bool has_bus_requests = any_of(stats_request.begin(),stats_request.end(),[](const StatsRequest& stat){
+            return stat.type == "Bus";
+        });
+        if(has_bus_requests){
+            bus_base->CalculateAndSetAllBusParams();
+        }
+
+}
+
+void ProcessBaseRequest(const map<string,Json::Node>& request,
+    shared_ptr<StopManager> stops_base,
+    shared_ptr<BusManager> bus_base) {
+    const auto& type = request.at("type").AsString();
+    if(type == "Stop"){
+        auto [stop_name,stop_info] = stops_base->ProcessStopRequest(request);
+        stops_base->AddStop(move(stop_name),move(stop_info));
+    }
+    else if(type == "Bus"){
+        auto [bus_name,bus_info] = bus_base->ProcessBusRequest(request);
+        bus_base->AddBusToStop(bus_name,bus_info);
+        bus_base->AddBus(bus_name,bus_info);
+    }
+}
+
+
+pair<shared_ptr<StopManager>,shared_ptr<BusManager>> CreateManagerWithConfig(const Json::Document& doc){
+    auto stops_base = make_shared<StopManager>();
+    auto bus_base = make_shared<BusManager>(stops_base);
+    const auto& root = doc.GetRoot().AsMap();
+    auto request_node = root.at("routing_settings");
+    bus_base->AddBusRoutingSettings(request_node);
+    return {move(stops_base),move(bus_base)};
+}
+
+
+tuple<vector<StatsRequest>,shared_ptr<StopManager>,shared_ptr<BusManager>> ProcessInput(const Json::Document& doc) {
+    auto[stops_base,bus_base] = CreateManagerWithConfig(doc);
+    const auto& root = doc.GetRoot().AsMap();
+    for(const auto& node : root.at("base_requests").AsArray()){
+        ProcessBaseRequest(node.AsMap(),stops_base,bus_base);
+    }
+    const auto& stats_request = ReadStatsRequests(root.at("stat_requests").AsArray());
+    ProcessStatsRequest(stats_request,stops_base,bus_base);
+    return {stats_request,stops_base,bus_base};
+}
+
+Json::Document ParceInput(istream& input){
+    auto doc = Json::Load(input);
+    return doc;
+}
+
+string ReadInput(istream& input){
+    return string(istreambuf_iterator<char>(input),istreambuf_iterator<char>());
+}
+
+namespace {
+
+struct BaseRecord{
+    optional<tuple<string,StopManager::StopsInfo>> stop;
+    optional<tuple<string,BusManager::BusInfo>> bus;
+};
+
+template <typename Result, typename Func>
+vector<Result> ParseElementsParallel(const vector<string_view>& elements,Func func){
+    vector<Result> result(elements.size());
+    const size_t chunk_size = 256;
+    const size_t chunk_count = (elements.size() + chunk_size - 1) / chunk_size;
+    ParallelFor(chunk_count,[&](size_t chunk){
+        const size_t end = min(elements.size(),(chunk + 1) * chunk_size);
+        for(size_t idx = chunk * chunk_size; idx < end; idx++){
+            result[idx] = func(Json::LoadNode(elements[idx]));
+        }
+    });
+    return result;
+}
+
+}
+
+tuple<vector<StatsRequest>,shared_ptr<StopManager>,shared_ptr<BusManager>> ProcessInputParallel(string_view input){
+    auto stops_base = make_shared<StopManager>();
+    auto bus_base = make_shared<BusManager>(stops_base);
+    optional<string_view> settings_text, base_text, stats_text;
+    for(const auto& [key,value] : Json::ScanObjectMembers(input)){
+        if(key == "routing_settings"){
+            settings_text = value;
+        }
+        else if(key == "base_requests"){
+            base_text = value;
+        }
+        else if(key == "stat_requests"){
+            stats_text = value;
+        }
+    }
+    // Missing sections fail with the same exception type as the map lookups in ProcessInput
+    for(const auto& [name,text] : {pair{"routing_settings",settings_text},pair{"base_requests",base_text},pair{"stat_requests",stats_text}}){
+        if(!text){
+            throw out_of_range(string("input has no ") + name);
+        }
+    }
+    bus_base->AddBusRoutingSettings(Json::LoadNode(*settings_text));
+
+    // Parsing only reads the managers, so chunks may run concurrently; merging stays
+    // serial because AddStop/AddBusToStop depend on the order stops are mentioned in.
+    auto records = ParseElementsParallel<BaseRecord>(Json::ScanArrayElements(*base_text),
+        [&stops_base,&bus_base](const Json::Node& node){
+            const auto& request = node.AsMap();
+            const auto& type = request.at("type").AsString();
+            BaseRecord record;
+            if(type == "Stop"){
+                record.stop = stops_base->ProcessStopRequest(request);
+            }
+            else if(type == "Bus"){
+                record.bus = bus_base->ProcessBusRequest(request);
+            }
+            return record;
+        });
+    for(auto& record : records){
+        if(record.stop){
+            auto& [stop_name,stop_info] = *record.stop;
+            stops_base->AddStop(move(stop_name),move(stop_info));
+        }
+        else if(record.bus){
+            auto& [bus_name,bus_info] = *record.bus;
+            bus_base->AddBusToStop(bus_name,bus_info);
+            bus_base->AddBus(bus_name,bus_info);
+        }
+    }
+    records = {};
+
+    const auto stat_nodes = ParseElementsParallel<Json::Node>(Json::ScanArrayElements(*stats_text),
+        [](Json::Node node){ return node; });
+    const auto& stats_request = ReadStatsRequests(stat_nodes);
+    ProcessStatsRequest(stats_request,stops_base,bus_base);
+    return {stats_request,stops_base,bus_base};
+}
+
+RoutingOptions ReadRoutingOptions(int argc, char* argv[]){
+    RoutingOptions options;
+    for(int i = 1; i < argc; i++){
+        const string_view arg = argv[i];
+        if(arg == "--router=hub_labels"){
+            options.engine = RouterEngine::HubLabels;
+        }
+        else if(arg == "--router=all_pairs"){
+            options.engine = RouterEngine::AllPairs;
+        }
+        else if(arg == "--router=overlay"){
+            options.engine = RouterEngine::Overlay;
+        }
+        else if(arg == "--router=disk"){
+            options.engine = RouterEngine::Disk;
+        }
+        else if(arg == "--router=cached_dijkstra"){
+            options.engine = RouterEngine::CachedDijkstra;
+        }
+        else if(arg == "--router=auto"){
+            options.engine = RouterEngine::Auto;
+        }
+        else if(arg.substr(0,9) == "--router="){
+            throw invalid_argument("unknown router engine '" + string(arg.substr(9))
+                + "', expected all_pairs, hub_labels, overlay, disk, cached_dijkstra or auto");
+        }
+        else if(arg.substr(0,19) == "--memory-budget-mb="){
+            options.memory_budget_bytes = static_cast<size_t>(stod(string(arg.substr(19))) * (1 << 20));
+        }
+        else if(arg.substr(0,20) == "--latency-target-us="){
+            options.latency_target_us = stod(string(arg.substr(20)));
+        }
+        else if(arg.substr(0,13) == "--disk-table="){
+            options.engine = RouterEngine::Disk;
+            options.disk_table_path = string(arg.substr(13));
+        }
+        else if(arg == "--vertex-order=hash"){
+            options.vertex_order = VertexOrder::Hash;
+        }
+        else if(arg == "--vertex-order=bus_route"){
+            options.vertex_order = VertexOrder::BusRoute;
+        }
+        else if(arg == "--vertex-order=rcm"){
+            options.vertex_order = VertexOrder::Rcm;
+        }
+        else if(arg == "--vertex-order=hilbert"){
+            options.vertex_order = VertexOrder::Hilbert;
+        }
+        else if(arg.substr(0,15) == "--vertex-order="){
+            throw invalid_argument("unknown vertex order '" + string(arg.substr(15))
+                + "', expected hash, bus_route, rcm or hilbert");
+        }
+        else if(arg.substr(0,20) == "--overlay-cell-size="){
+            options.engine = RouterEngine::Overlay;
+            options.overlay_cell_size = stoul(string(arg.substr(20)));
+        }
+        else if(arg.substr(0,14) == "--route-cache="){
+            options.route_cache_capacity = stoul(string(arg.substr(14)));
+        }
+        else if(arg.substr(0,13) == "--hub-labels="){
+            options.engine = RouterEngine::HubLabels;
+            options.hub_labels_path = string(arg.substr(13));
+        }
+    }
+    return options;
+}
+
+void ApplyProfileOptions(int argc, char* argv[]){
+    for(int i = 1; i < argc; i++){
+        const string_view arg = argv[i];
+        if(arg == "--stats"){
+            Profile::Enable();
+        }
+        else if(arg.substr(0,16) == "--slow-route-us="){
+            Profile::SetSlowRouteThreshold(static_cast<uint64_t>(stod(string(arg.substr(16))) * 1000));
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "json.h"
+#include "StopsBase.h"
+#include "Bus.h"
+#include "Transport.h"
+#include "ResponseCache.h"
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+struct StatsRequest{
+    std::string type;
+    std::string name;
+    std::string from;
+    std::string to;
+    long long request_id;
+    // Route requests may override the routing settings of the base
+    std::optional<BusManager::RouteSettings> routing_settings;
+};
+
+void PrintBusResult(const StatsRequest& stat,
+    std::shared_ptr<BusManager> bus_base, std::ostream& out = std::cout);
+void PrintStopResult(const StatsRequest& stat, std::shared_ptr<StopManager> stops_base, std::ostream& out = std::cout);
+void PrintBusResult(const StatsRequest& stat, const ResponseCache& response_cache, std::ostream& out = std::cout);
+void PrintStopResult(const StatsRequest& stat, const ResponseCache& response_cache, std::ostream& out = std::cout);
+void PrintRouteResult(const StatsRequest& stat, const TransportSystem& transport_system, std::ostream& out = std::cout);
+void PrintResult(const std::vector<StatsRequest>& stats_request,
+    std::shared_ptr<StopManager> stops_base,
+    std::shared_ptr<BusManager> bus_base,const TransportSystem& transport_system, std::ostream& out = std::cout);
+
+// Same output as PrintResult. Stop/Bus responses are answered while the router is built on a
+// background thread; the router is not built at all when there are no Route requests.
+void PrintResultPipelined(const std::vector<StatsRequest>& stats_request,
+    std::shared_ptr<StopManager> stops_base,
+    std::shared_ptr<BusManager> bus_base,const RoutingOptions& routing_options, std::ostream& out = std::cout);
+
+void CalculateAndSetBusParams(std::shared_ptr<BusManager> bus_base, const std::string& bus_num);
+std::vector<StatsRequest> ReadStatsRequests(const std::vector<Json::Node>& stats_request);
+void ProcessStatsRequest(const std::vector<StatsRequest>& stats_request,
+    std::shared_ptr<StopManager> stops_base,
+    std::shared_ptr<BusManager> bus_base);
+void ProcessBaseRequest(const std::map<std::string,Json::Node>& request,
+    std::shared_ptr<StopManager> stops_base,
+    std::shared_ptr<BusManager> bus_base);
+
+std::pair<std::shared_ptr<StopManager>,std::shared_ptr<BusManager>> CreateManagerWithConfig(const Json::Document& doc);
+std::tuple<std::vector<StatsRequest>,std::shared_ptr<StopManager>,std::shared_ptr<BusManager>> ProcessInput(const Json::Document& doc);
+Json::Document ParceInput(std::istream& input = std::cin);
+
+// Same result as ProcessInput(ParceInput(...)), but base_requests and stat_requests are split
+// into chunks by a structural pre-scan and parsed on several threads. Records are then applied
+// to the managers serially in input order.
+std::tuple<std::vector<StatsRequest>,std::shared_ptr<StopManager>,std::shared_ptr<BusManager>> ProcessInputParallel(std::string_view input);
+std::string ReadInput(std::istream& input = std::cin);
+
+// Throws std::invalid_argument on an unknown --router= or --vertex-order= value.
+RoutingOptions ReadRoutingOptions(int argc, char* argv[]);
+// Handles --stats and --slow-route-us=<threshold>.
+void ApplyProfileOptions(int argc, char* argv[]);
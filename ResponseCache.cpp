@@ -0,0 +1,123 @@
+#include "ResponseCache.h"
+#include "parallel.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+template <typename Entry>
+void SortUnique(vector<const Entry*>& entries){
+    sort(entries.begin(),entries.end());
+    entries.erase(unique(entries.begin(),entries.end()),entries.end());
+}
+
+}
+
+ResponseCache::ResponseCache(shared_ptr<const StopManager> stops_base,shared_ptr<const BusManager> bus_base)
+    : stops_base_ptr_(move(stops_base)), bus_base_ptr_(move(bus_base)){
+    vector<const StopEntry*> stops;
+    for(const auto& it : *stops_base_ptr_){
+        stops.push_back(&it);
+    }
+    vector<const BusEntry*> buses;
+    for(const auto& it : *bus_base_ptr_){
+        buses.push_back(&it);
+    }
+    Render(stops,buses);
+}
+
+ResponseCache::ResponseCache(shared_ptr<const StopManager> stops_base,shared_ptr<const BusManager> bus_base,
+    const vector<string_view>& stop_names,const vector<string_view>& bus_names)
+    : stops_base_ptr_(move(stops_base)), bus_base_ptr_(move(bus_base)){
+    vector<const StopEntry*> stops;
+    for(string_view name : stop_names){
+        if(auto it = stops_base_ptr_->FindStop(string(name)); it != stops_base_ptr_->end()){
+            stops.push_back(&*it);
+        }
+    }
+    vector<const BusEntry*> buses;
+    for(string_view name : bus_names){
+        if(auto it = bus_base_ptr_->FindBus(string(name)); it != bus_base_ptr_->end()){
+            buses.push_back(&*it);
+        }
+    }
+    SortUnique(stops);
+    SortUnique(buses);
+    Render(stops,buses);
+}
+
+void ResponseCache::Render(const vector<const StopEntry*>& stops,const vector<const BusEntry*>& buses){
+    vector<RenderedBody> bodies(stops.size() + buses.size());
+    ParallelFor(bodies.size(),[&](size_t idx){
+        ostringstream prefix;
+        ostringstream suffix;
+        if(idx < stops.size()){
+            prefix << "   " << '"' << "buses" << '"' << ": [" << stops[idx]->second << "]," << endl;
+            prefix << "   " << '"' << "request_id" << '"' << ": ";
+            suffix << endl;
+        }
+        else{
+            const auto& bus_info = bus_base_ptr_->GetPattern(buses[idx - stops.size()]->second);
+            prefix << "   "  << '"' << "route_length" << '"' << ": " << bus_info.road_length << "," << endl;
+            prefix << "   "  << '"' << "request_id" << '"' << ": ";
+            suffix << ","<< endl;
+            suffix << "   "  << '"' << "curvature" << '"' << ": " << bus_info.curvature << "," << endl;
+            suffix << "   "  << '"' << "stop_count" << '"' << ": " << bus_info.cnt_stops << "," << endl;
+            suffix << "   "  << '"' << "unique_stop_count" << '"' << ": " << bus_info.unique_stops << endl;
+        }
+        bodies[idx] = {prefix.str(),suffix.str()};
+    });
+
+    size_t arena_size = 0;
+    for(const auto& body : bodies){
+        arena_size += body.prefix.size() + body.suffix.size();
+    }
+    arena_.reserve(arena_size);
+    entries_.reserve(bodies.size());
+    stop_ids_.reserve(stops.size());
+    bus_ids_.reserve(buses.size());
+    for(size_t idx = 0; idx < bodies.size(); idx++){
+        const size_t entry_id = AddEntry(bodies[idx]);
+        if(idx < stops.size()){
+            stop_ids_[stops[idx]->first] = entry_id;
+        }
+        else{
+            bus_ids_[buses[idx - stops.size()]->first] = entry_id;
+        }
+    }
+
+    ostringstream not_found_suffix;
+    not_found_suffix << "," << endl;
+    not_found_suffix << "   " << '"' << "error_message" << '"' << ": " << '"' << "not found" << '"' << endl;
+    not_found_ = entries_[AddEntry({"   \"request_id\": ",not_found_suffix.str()})];
+}
+
+size_t ResponseCache::AddEntry(const RenderedBody& body){
+    entries_.push_back({arena_.size(),static_cast<uint32_t>(body.prefix.size()),static_cast<uint32_t>(body.suffix.size())});
+    arena_ += body.prefix;
+    arena_ += body.suffix;
+    return entries_.size() - 1;
+}
+
+void ResponseCache::WriteEntry(const Entry& entry,long long request_id,ostream& out) const{
+    out.write(arena_.data() + entry.offset,entry.prefix_size);
+    out << request_id;
+    out.write(arena_.data() + entry.offset + entry.prefix_size,entry.suffix_size);
+}
+
+void ResponseCache::WriteStopResponse(string_view stop_name,long long request_id,ostream& out) const{
+    auto it = stop_ids_.find(stop_name);
+    WriteEntry(it == stop_ids_.end() ? not_found_ : entries_[it->second],request_id,out);
+}
+
+void ResponseCache::WriteBusResponse(string_view bus_name,long long request_id,ostream& out) const{
+    auto it = bus_ids_.find(bus_name);
+    WriteEntry(it == bus_ids_.end() ? not_found_ : entries_[it->second],request_id,out);
+}
+
+size_t ResponseCache::GetMemoryBytes() const{
+    return arena_.capacity() + entries_.capacity() * sizeof(Entry)
+        + (stop_ids_.size() + bus_ids_.size()) * (sizeof(string_view) + 2 * sizeof(size_t));
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "StopsBase.h"
+#include "Bus.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Stop and Bus responses rendered once at load time. Every body is stored in one
+// arena as a prefix and a suffix around the request id, so answering a request
+// is one hash lookup and two writes. Bus stats must already be calculated
+// (BusManager::CalculateAndSetAllBusParams): the cache only reads the managers.
+class ResponseCache{
+public:
+    // Renders every stop and bus
+    ResponseCache(std::shared_ptr<const StopManager> stops_base,std::shared_ptr<const BusManager> bus_base);
+    // Renders only the named stops and buses; any other name is answered as not found
+    ResponseCache(std::shared_ptr<const StopManager> stops_base,std::shared_ptr<const BusManager> bus_base,
+        const std::vector<std::string_view>& stop_names,const std::vector<std::string_view>& bus_names);
+
+    void WriteStopResponse(std::string_view stop_name,long long request_id,std::ostream& out) const;
+    void WriteBusResponse(std::string_view bus_name,long long request_id,std::ostream& out) const;
+    size_t GetMemoryBytes() const;
+
+private:
+    struct Entry{
+        size_t offset = 0;
+        uint32_t prefix_size = 0;
+        uint32_t suffix_size = 0;
+    };
+
+    using StopEntry = std::pair<const std::string,StopManager::StopsInfo>;
+    using BusEntry = std::pair<const std::string,size_t>;
+
+    std::shared_ptr<const StopManager> stops_base_ptr_;
+    std::shared_ptr<const BusManager> bus_base_ptr_;
+    std::string arena_;
+    std::vector<Entry> entries_;
+    std::unordered_map<std::string_view,size_t> stop_ids_;
+    std::unordered_map<std::string_view,size_t> bus_ids_;
+    Entry not_found_;
+
+    struct RenderedBody{
+        std::string prefix;
+        std::string suffix;
+    };
+    void Render(const std::vector<const StopEntry*>& stops,const std::vector<const BusEntry*>& buses);
+    size_t AddEntry(const RenderedBody& body);
+    void WriteEntry(const Entry& entry,long long request_id,std::ostream& out) const;
+};
@@ -0,0 +1,89 @@
+#include "RouteCache.h"
+
+using namespace std;
+
+RouteCache::RouteCache(size_t capacity) : capacity_(capacity), shards_(SHARD_COUNT){
+    for(size_t idx = 0; idx < SHARD_COUNT; idx++){
+        shards_[idx].capacity = capacity / SHARD_COUNT + (idx < capacity % SHARD_COUNT ? 1 : 0);
+    }
+}
+
+uint64_t RouteCache::MakeKey(Graph::VertexId from,Graph::VertexId to){
+    return (static_cast<uint64_t>(from) << 32) ^ static_cast<uint64_t>(to);
+}
+
+RouteCache::Shard& RouteCache::GetShard(uint64_t key) const{
+    const uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    return shards_[(hash >> 32) % SHARD_COUNT];
+}
+
+optional<shared_ptr<const RenderedRoute>> RouteCache::Get(Graph::VertexId from,Graph::VertexId to) const{
+    const uint64_t key = MakeKey(from,to);
+    Shard& shard = GetShard(key);
+    {
+        lock_guard<mutex> guard(shard.mutex);
+        auto it = shard.index.find(key);
+        if(it != shard.index.end()){
+            Slot& slot = shard.slots[it->second];
+            slot.referenced = true;
+            hits_++;
+            return slot.route;
+        }
+    }
+    misses_++;
+    return nullopt;
+}
+
+void RouteCache::Put(Graph::VertexId from,Graph::VertexId to,shared_ptr<const RenderedRoute> route){
+    const uint64_t key = MakeKey(from,to);
+    Shard& shard = GetShard(key);
+    if(shard.capacity == 0){
+        return;
+    }
+    lock_guard<mutex> guard(shard.mutex);
+    if(auto it = shard.index.find(key); it != shard.index.end()){
+        shard.slots[it->second].route = move(route);
+        return;
+    }
+    if(shard.slots.size() < shard.capacity){
+        shard.index[key] = shard.slots.size();
+        shard.slots.push_back({key,move(route),false});
+        return;
+    }
+    // CLOCK: give every referenced slot a second chance before evicting it
+    while(shard.slots[shard.hand].referenced){
+        shard.slots[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+    }
+    Slot& victim = shard.slots[shard.hand];
+    shard.index.erase(victim.key);
+    shard.index[key] = shard.hand;
+    victim = {key,move(route),false};
+    shard.hand = (shard.hand + 1) % shard.slots.size();
+    evictions_++;
+}
+
+void RouteCache::Clear(){
+    for(auto& shard : shards_){
+        lock_guard<mutex> guard(shard.mutex);
+        shard.slots.clear();
+        shard.index.clear();
+        shard.hand = 0;
+    }
+}
+
+size_t RouteCache::GetCapacity() const{
+    return capacity_;
+}
+
+uint64_t RouteCache::GetHitCount() const{
+    return hits_;
+}
+
+uint64_t RouteCache::GetMissCount() const{
+    return misses_;
+}
+
+uint64_t RouteCache::GetEvictionCount() const{
+    return evictions_;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "graph.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct RenderedRoute{
+    double total_time = 0.0;
+    size_t item_count = 0;
+    std::string items;
+};
+
+// Bounded concurrent cache of rendered routes keyed on (from, to) vertices.
+// Keys are spread over independently locked shards, each evicting with the CLOCK policy;
+// the capacity is split between the shards, so the cache never holds more than it was given.
+// A cached nullptr means that the pair has no route.
+class RouteCache{
+public:
+    explicit RouteCache(size_t capacity);
+
+    std::optional<std::shared_ptr<const RenderedRoute>> Get(Graph::VertexId from,Graph::VertexId to) const;
+    void Put(Graph::VertexId from,Graph::VertexId to,std::shared_ptr<const RenderedRoute> route);
+    void Clear();
+
+    size_t GetCapacity() const;
+    uint64_t GetHitCount() const;
+    uint64_t GetMissCount() const;
+    uint64_t GetEvictionCount() const;
+
+private:
+    struct Slot{
+        uint64_t key;
+        std::shared_ptr<const RenderedRoute> route;
+        bool referenced;
+    };
+    struct Shard{
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        std::unordered_map<uint64_t,size_t> index;
+        size_t hand = 0;
+        size_t capacity = 0;
+    };
+
+    static constexpr size_t SHARD_COUNT = 16;
+
+    size_t capacity_;
+    mutable std::vector<Shard> shards_;
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+
+    static uint64_t MakeKey(Graph::VertexId from,Graph::VertexId to);
+    Shard& GetShard(uint64_t key) const;
+};
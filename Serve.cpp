@@ -0,0 +1,433 @@
+#include "Serve.h"
+#include "Requests.h"
+#include "ResponseCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+bool WriteAll(int fd, const char* data, size_t size){
+    while(size > 0){
+        const ssize_t written = write(fd,data,size);
+        if(written <= 0){
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool ReadAll(int fd, char* data, size_t size){
+    while(size > 0){
+        const ssize_t received = read(fd,data,size);
+        if(received <= 0){
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool WriteFrame(int fd, string_view payload){
+    const uint32_t size = payload.size();
+    return WriteAll(fd,reinterpret_cast<const char*>(&size),sizeof(size)) && WriteAll(fd,payload.data(),payload.size());
+}
+
+optional<string> ReadFrame(int fd){
+    uint32_t size = 0;
+    if(!ReadAll(fd,reinterpret_cast<char*>(&size),sizeof(size))){
+        return nullopt;
+    }
+    string payload(size,'\0');
+    if(!ReadAll(fd,payload.data(),size)){
+        return nullopt;
+    }
+    return payload;
+}
+
+// A batch is either an array of stat requests or a document holding them under "stat_requests".
+vector<string_view> SplitBatch(string_view batch){
+    for(const auto& [key,value] : Json::ScanObjectMembers(batch)){
+        if(key == "stat_requests"){
+            return Json::ScanArrayElements(value);
+        }
+    }
+    return Json::ScanArrayElements(batch);
+}
+
+vector<StatsRequest> ParseRequests(const vector<string_view>& elements){
+    vector<Json::Node> nodes;
+    nodes.reserve(elements.size());
+    for(string_view element : elements){
+        nodes.push_back(Json::LoadNode(element));
+    }
+    return ReadStatsRequests(nodes);
+}
+
+template <typename Value>
+void AppendValue(string& output, const Value& value){
+    output.append(reinterpret_cast<const char*>(&value),sizeof(value));
+}
+
+template <typename Value>
+Value ReadValue(string_view& input){
+    Value value;
+    memcpy(&value,input.data(),sizeof(value));
+    input.remove_prefix(sizeof(value));
+    return value;
+}
+
+void AppendString(string& output, string_view value){
+    AppendValue<uint32_t>(output,value.size());
+    output += value;
+}
+
+optional<string_view> ReadString(string_view& input){
+    if(input.size() < sizeof(uint32_t)){
+        return nullopt;
+    }
+    const uint32_t size = ReadValue<uint32_t>(input);
+    if(input.size() < size){
+        return nullopt;
+    }
+    const string_view value = input.substr(0,size);
+    input.remove_prefix(size);
+    return value;
+}
+
+// Route requests travel to the workers already parsed: id, origin, destination and the
+// optional routing settings, so the JSON of a batch is parsed once, by the dispatcher.
+void AppendRouteRequest(string& output, const StatsRequest& stat){
+    AppendValue(output,stat.request_id);
+    AppendString(output,stat.from);
+    AppendString(output,stat.to);
+    AppendValue<uint8_t>(output,stat.routing_settings.has_value());
+    if(stat.routing_settings){
+        AppendValue(output,stat.routing_settings->bus_wait_time);
+        AppendValue(output,stat.routing_settings->bus_velocity);
+    }
+}
+
+StatsRequest ReadRouteRequest(string_view& input){
+    StatsRequest stat{"Route",{},{},{},0,nullopt};
+    stat.request_id = ReadValue<long long>(input);
+    stat.from = string(*ReadString(input));
+    stat.to = string(*ReadString(input));
+    if(ReadValue<uint8_t>(input)){
+        BusManager::RouteSettings settings;
+        settings.bus_wait_time = ReadValue<double>(input);
+        settings.bus_velocity = ReadValue<double>(input);
+        stat.routing_settings = settings;
+    }
+    return stat;
+}
+
+// Answers route batches from the dispatcher until it closes the channel. The reply to a batch
+// is the response body of every request, each prefixed with its size.
+void RunWorker(int channel, const TransportSystem& transport_system){
+    ostringstream response;
+    while(auto batch = ReadFrame(channel)){
+        string reply;
+        for(string_view input = *batch; !input.empty(); ){
+            response.str({});
+            PrintRouteResult(ReadRouteRequest(input),transport_system,response);
+            AppendString(reply,response.str());
+        }
+        if(!WriteFrame(channel,reply)){
+            break;
+        }
+    }
+}
+
+struct Worker{
+    pid_t pid;
+    int channel;
+    // Held for a whole exchange, so batches of concurrent clients never interleave on the channel
+    mutex lock;
+    atomic<bool> alive{true};
+};
+
+struct Dispatcher{
+    Dispatcher(const ResponseCache& response_cache, const TransportSystem& transport_system)
+        : response_cache(response_cache), transport_system(transport_system){
+    }
+
+    const ResponseCache& response_cache;
+    const TransportSystem& transport_system;
+    vector<unique_ptr<Worker>> workers;
+
+    mutex clients_lock;
+    condition_variable clients_done;
+    size_t active_clients = 0;
+};
+
+// Stops a worker whose channel failed; the remaining workers take over its vertices.
+// The caller holds worker.lock.
+void RetireWorker(Worker& worker){
+    worker.alive = false;
+    close(worker.channel);
+    kill(worker.pid,SIGKILL);
+    waitpid(worker.pid,nullptr,0);
+    cerr << "serve: worker " << worker.pid << " failed and was retired" << endl;
+}
+
+// Sends every shard, then reads every reply, so the workers run concurrently. Workers are
+// locked in index order, which keeps concurrent batches free of deadlocks.
+void ExchangeShards(Dispatcher& dispatcher, const vector<StatsRequest>& requests,
+    const vector<pair<size_t,vector<size_t>>>& shards, vector<string>& responses){
+    vector<unique_lock<mutex>> locks;
+    for(const auto& [worker,indices] : shards){
+        locks.emplace_back(dispatcher.workers[worker]->lock);
+    }
+    bool failed = false;
+    vector<bool> sent(shards.size(),false);
+    for(size_t shard = 0; shard < shards.size(); shard++){
+        Worker& worker = *dispatcher.workers[shards[shard].first];
+        if(!worker.alive){
+            failed = true;
+            continue;
+        }
+        string batch;
+        for(size_t idx : shards[shard].second){
+            AppendRouteRequest(batch,requests[idx]);
+        }
+        sent[shard] = WriteFrame(worker.channel,batch);
+        if(!sent[shard]){
+            failed = true;
+            RetireWorker(worker);
+        }
+    }
+    for(size_t shard = 0; shard < shards.size(); shard++){
+        if(!sent[shard]){
+            continue;
+        }
+        Worker& worker = *dispatcher.workers[shards[shard].first];
+        auto reply = ReadFrame(worker.channel);
+        bool complete = reply.has_value();
+        string_view input = reply ? string_view(*reply) : string_view();
+        for(size_t idx : shards[shard].second){
+            const auto body = complete ? ReadString(input) : nullopt;
+            if(!body){
+                complete = false;
+                break;
+            }
+            responses[idx] = string(*body);
+        }
+        if(!complete){
+            failed = true;
+            RetireWorker(worker);
+        }
+    }
+    // The pid of the failed worker goes to stderr only, so the reply does not vary from run to run
+    if(failed){
+        throw runtime_error("serve: a worker failed while answering the batch");
+    }
+}
+
+string AnswerBatch(string_view batch, Dispatcher& dispatcher){
+    const auto requests = ParseRequests(SplitBatch(batch));
+    vector<size_t> alive;
+    for(size_t worker = 0; worker < dispatcher.workers.size(); worker++){
+        if(dispatcher.workers[worker]->alive){
+            alive.push_back(worker);
+        }
+    }
+
+    // Stop and Bus answers are arena copies, so only routes are worth the trip to a worker.
+    // Routes are split by ranges of the origin vertex: the vertex order keeps nearby stops
+    // together, so each worker's router caches cover one region.
+    vector<string> responses(requests.size());
+    vector<vector<size_t>> assigned(dispatcher.workers.size());
+    const size_t vertex_count = max<size_t>(1,dispatcher.transport_system.GetGraph().GetVertexCount());
+    ostringstream response;
+    for(size_t idx = 0; idx < requests.size(); idx++){
+        const auto& stat = requests[idx];
+        if(stat.type == "Route" && !alive.empty()){
+            const auto vertex = dispatcher.transport_system.GetStopVertex(stat.from);
+            assigned[alive[vertex ? *vertex * alive.size() / vertex_count : 0]].push_back(idx);
+            continue;
+        }
+        response.str({});
+        if(stat.type == "Stop"){
+            PrintStopResult(stat,dispatcher.response_cache,response);
+        }
+        else if(stat.type == "Bus"){
+            PrintBusResult(stat,dispatcher.response_cache,response);
+        }
+        else if(stat.type == "Route"){
+            // Every worker has been retired: the dispatcher routes by itself
+            PrintRouteResult(stat,dispatcher.transport_system,response);
+        }
+        responses[idx] = response.str();
+    }
+    vector<pair<size_t,vector<size_t>>> shards;
+    for(size_t worker = 0; worker < assigned.size(); worker++){
+        if(!assigned[worker].empty()){
+            shards.emplace_back(worker,move(assigned[worker]));
+        }
+    }
+    if(!shards.empty()){
+        ExchangeShards(dispatcher,requests,shards,responses);
+    }
+
+    ostringstream out;
+    out << '[' << endl;
+    for(size_t idx = 0; idx < responses.size(); idx++){
+        out << "  {\n" << responses[idx] << "  }";
+        if(idx + 1 < responses.size()){
+            out << ',';
+        }
+        out << '\n';
+    }
+    out << ']' << endl;
+    return out.str();
+}
+
+// Runs on its own thread for every client. A batch that fails (malformed input, a worker lost
+// in the middle of it) is answered with an error and the connection stays open.
+void ServeClient(int client, Dispatcher& dispatcher){
+    while(auto batch = ReadFrame(client)){
+        string reply;
+        try{
+            reply = AnswerBatch(*batch,dispatcher);
+        }
+        catch(const exception& error){
+            ostringstream out;
+            out << "{\"error_message\": ";
+            Json::PrintString(out,error.what());
+            out << "}\n";
+            reply = out.str();
+        }
+        if(!WriteFrame(client,reply)){
+            break;
+        }
+    }
+    close(client);
+    lock_guard guard(dispatcher.clients_lock);
+    if(--dispatcher.active_clients == 0){
+        dispatcher.clients_done.notify_all();
+    }
+}
+
+int ListenOn(const string& socket_path){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if(socket_path.size() >= sizeof(address.sun_path)){
+        throw runtime_error("serve: socket path is too long");
+    }
+    strcpy(address.sun_path,socket_path.c_str());
+    const int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    unlink(socket_path.c_str());
+    if(fd < 0 || bind(fd,reinterpret_cast<sockaddr*>(&address),sizeof(address)) != 0 || listen(fd,16) != 0){
+        throw runtime_error("serve: cannot listen on " + socket_path);
+    }
+    return fd;
+}
+
+}
+
+int RunDispatcher(const string& socket_path, size_t worker_count,
+    shared_ptr<StopManager> stops_base, shared_ptr<BusManager> bus_base,
+    const RoutingOptions& routing_options){
+    bus_base->CalculateAndSetAllBusParams();
+    const ResponseCache response_cache(stops_base,bus_base);
+    const TransportSystem transport_system(bus_base,stops_base,routing_options);
+
+    // Workers are forked before any client thread exists
+    Dispatcher dispatcher(response_cache,transport_system);
+    for(size_t idx = 0; idx < max<size_t>(worker_count,1); idx++){
+        int channel[2];
+        if(socketpair(AF_UNIX,SOCK_STREAM,0,channel) != 0){
+            throw runtime_error("serve: cannot create a worker channel");
+        }
+        const pid_t pid = fork();
+        if(pid < 0){
+            throw runtime_error("serve: cannot start a worker");
+        }
+        if(pid == 0){
+            close(channel[0]);
+            for(const auto& worker : dispatcher.workers){
+                close(worker->channel);
+            }
+            RunWorker(channel[1],transport_system);
+            _exit(0);
+        }
+        close(channel[1]);
+        auto worker = make_unique<Worker>();
+        worker->pid = pid;
+        worker->channel = channel[0];
+        dispatcher.workers.push_back(move(worker));
+    }
+
+    signal(SIGPIPE,SIG_IGN);
+    const int listener = ListenOn(socket_path);
+    cerr << "serving " << socket_path << " with " << dispatcher.workers.size() << " workers" << endl;
+    for(;;){
+        const int client = accept(listener,nullptr,nullptr);
+        if(client < 0){
+            break;
+        }
+        {
+            lock_guard guard(dispatcher.clients_lock);
+            dispatcher.active_clients++;
+        }
+        thread(ServeClient,client,ref(dispatcher)).detach();
+    }
+
+    close(listener);
+    unlink(socket_path.c_str());
+    {
+        unique_lock guard(dispatcher.clients_lock);
+        dispatcher.clients_done.wait(guard,[&dispatcher]{ return dispatcher.active_clients == 0; });
+    }
+    for(const auto& worker : dispatcher.workers){
+        if(worker->alive){
+            close(worker->channel);
+            waitpid(worker->pid,nullptr,0);
+        }
+    }
+    return 0;
+}
+
+int RunClient(const string& socket_path, istream& input, ostream& output){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path,socket_path.c_str(),sizeof(address.sun_path) - 1);
+    const int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd < 0 || connect(fd,reinterpret_cast<sockaddr*>(&address),sizeof(address)) != 0){
+        cerr << "cannot connect to " << socket_path << endl;
+        return 1;
+    }
+    const string batch(istreambuf_iterator<char>(input),istreambuf_iterator<char>{});
+    optional<string> reply;
+    if(WriteFrame(fd,batch)){
+        reply = ReadFrame(fd);
+    }
+    close(fd);
+    if(!reply){
+        cerr << "no reply from " << socket_path << endl;
+        return 1;
+    }
+    output << *reply;
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "StopsBase.h"
+#include "Bus.h"
+#include "Transport.h"
+#include <iostream>
+#include <memory>
+#include <string>
+
+// Sharded serving over a Unix domain socket. A client sends a batch of stat requests
+// (a JSON array, or a whole input document with "stat_requests") as one frame: a 4-byte
+// length followed by the payload. The dispatcher answers with one frame holding the
+// same JSON array the batch mode prints.
+//
+// The dispatcher builds the transport system once and forks the workers afterwards, so
+// all of them share the built snapshot copy-on-write. Every client is served on its own
+// thread, which parses the batch once and answers Stop and Bus requests itself. Route
+// requests go to the worker owning the range of the origin vertex, so its router caches see
+// the same sources; responses are merged back in request order. A failed batch is answered
+// with {"error_message": ...}. A worker whose channel fails is retired and the others take
+// over its vertices; with no workers left the dispatcher routes by itself.
+int RunDispatcher(const std::string& socket_path, size_t worker_count,
+    std::shared_ptr<StopManager> stops_base, std::shared_ptr<BusManager> bus_base,
+    const RoutingOptions& routing_options);
+
+// Sends the stat requests of the input to a dispatcher and prints its answer.
+int RunClient(const std::string& socket_path, std::istream& input = std::cin, std::ostream& output = std::cout);
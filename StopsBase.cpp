@@ -33,23 +33,30 @@ tuple<string,StopManager::StopsInfo> StopManager::ProcessStopRequest(const map<s
     return {stop_name,stop_info};
 }
 
+StopManager::StopsInfo& StopManager::GetOrCreateStop(const std::string& stop_name){
+    auto [it,inserted] = stops_data_.try_emplace(stop_name);
+    if(inserted){
+        it->second.id = stops_data_.size() - 1;
+        stops_by_id_.push_back(&*it);
+        coordinates_store_.Set(it->second.id,0.0,0.0);
+    }
+    return it->second;
+}
+
 void StopManager::AddStop(const std::string& stop_name,const StopManager::StopsInfo& stop_info){
-    if(stops_data_.find(stop_name) == stops_data_.end()){
-        stops_data_[stop_name] = stop_info;
+    auto& stop = GetOrCreateStop(stop_name);
+    for(const auto& bus : stop_info.buses_){
+        stop.buses_.insert(bus);
     }
-    else{
-        for(const auto& bus : stop_info.buses_){
-            stops_data_[stop_name].buses_.insert(bus);
-        }
-        for(const auto& [key,val] : stop_info.stops_to_distances_){
-            stops_data_[stop_name].stops_to_distances_[key] = val;
-        }
-        stops_data_[stop_name].coordinates = stop_info.coordinates;
+    for(const auto& [key,val] : stop_info.stops_to_distances_){
+        stop.stops_to_distances_[key] = val;
     }
+    stop.coordinates = stop_info.coordinates;
+    coordinates_store_.Set(stop.id,stop.coordinates.latitude,stop.coordinates.longitude);
 }
 
 void StopManager::AddStopBus(const std::string& bus_num,const std::string& stop_name){
-    stops_data_[stop_name].buses_.insert(bus_num);
+    GetOrCreateStop(stop_name).buses_.insert(bus_num);
 }
 
 bool StopManager::HasBusOnStop(const std::string& stop_name,const std::string& bus_name) const{
@@ -67,6 +74,18 @@ optional<Coordinates> StopManager::GetStopCoordinates(const std::string& stop_na
     return nullopt;
 }
 
+optional<size_t> StopManager::GetStopId(const std::string& stop_name) const{
+    auto it = stops_data_.find(stop_name);
+    if(it == stops_data_.end()){
+        return nullopt;
+    }
+    return it->second.id;
+}
+
+const CoordinatesStore& StopManager::GetCoordinatesStore() const{
+    return coordinates_store_;
+}
+
 const StopManager::StopsInfo& StopManager::GetStopInfo(const std::string& stop_name) const{
     return stops_data_.at(stop_name);
 }
@@ -85,6 +104,22 @@ double StopManager::GetDistance(const string& from_stop,const string& to_stop) c
     return 0.0;
 }
 
+double StopManager::GetDistance(size_t from_id,size_t to_id) const{
+    const auto& [from_stop,from_info] = *stops_by_id_[from_id];
+    const auto& [to_stop,to_info] = *stops_by_id_[to_id];
+    if(auto it = from_info.stops_to_distances_.find(to_stop); it != from_info.stops_to_distances_.end()){
+        return it->second;
+    }
+    if(auto it = to_info.stops_to_distances_.find(from_stop); it != to_info.stops_to_distances_.end()){
+        return it->second;
+    }
+    return 0.0;
+}
+
+const string& StopManager::GetStopName(size_t stop_id) const{
+    return stops_by_id_[stop_id]->first;
+}
+
 size_t StopManager::GetDataSize() const{
     return stops_data_.size();
 }
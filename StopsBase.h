@@ -1,5 +1,6 @@
 #pragma once
 #include "json.h"
+#include "Geo.h"
 #include <unordered_map>
 #include <map>
 #include <optional>
@@ -7,6 +8,7 @@
 #include <tuple>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <iostream>
 
 static const double Pi = 3.1415926535;
@@ -27,6 +29,7 @@ public:
         Coordinates coordinates;
         std::set<std::string> buses_;
         std::unordered_map<std::string,double> stops_to_distances_;
+        size_t id = 0;
     };
     StopManager() = default;
     ~StopManager() = default;
@@ -40,10 +43,17 @@ public:
     auto end() const{
         return stops_data_.end();
     }
+    auto FindStop(const std::string& stop_name) const{
+        return stops_data_.find(stop_name);
+    }
     const StopsInfo& GetStopInfo(const std::string& stop_name) const;
     std::optional<Coordinates> GetStopCoordinates(const std::string& stop_name) const;
+    std::optional<size_t> GetStopId(const std::string& stop_name) const;
+    const CoordinatesStore& GetCoordinatesStore() const;
     size_t GetDataSize() const;
     double GetDistance(const std::string& from_stop,const std::string& to_stop) const;
+    double GetDistance(size_t from_id,size_t to_id) const;
+    const std::string& GetStopName(size_t stop_id) const;
 
     bool HasBusesOnStop(const std::string& stop_name) const;
     bool HasBusOnStop(const std::string& stop_name,const std::string& bus_name) const;
@@ -52,8 +62,12 @@ public:
 private:
 
     void AddStopBus(const std::string& bus_num,const std::string& stop_name);
+    StopsInfo& GetOrCreateStop(const std::string& stop_name);
     
     std::unordered_map<std::string,StopsInfo> stops_data_;
+    // stops_data_ entries by stop id; node addresses are stable
+    std::vector<std::unordered_map<std::string,StopsInfo>::value_type*> stops_by_id_;
+    CoordinatesStore coordinates_store_;
 };
 
 std::ostream& operator << (std::ostream& out,const StopManager::StopsInfo& stops_info);
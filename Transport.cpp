@@ -1,100 +1,581 @@
 #include "Transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <unistd.h>
+#include <sstream>
 
 using namespace std;
 
-TransportSystem::TransportSystem(shared_ptr<BusManager> bus_base,shared_ptr<StopManager> stop_base) : 
-bus_base_ptr_(bus_base), stops_base_ptr_(stop_base), graph_(stops_base_ptr_->GetDataSize()){
-    BuildGraph();
-    BuildRouter();
+TransportSystem::TransportSystem(shared_ptr<BusManager> bus_base,shared_ptr<StopManager> stop_base,RoutingOptions options) : 
+bus_base_ptr_(bus_base), stops_base_ptr_(stop_base), graph_(stops_base_ptr_->GetDataSize()), options_(move(options)),
+routing_settings_(bus_base_ptr_->GetRouteSettings()){
+    {
+        Profile::PhaseTimer timer("build_graph");
+        BuildGraph();
+    }
+    if(options_.build_reachability){
+        Profile::PhaseTimer timer("build_reachability");
+        reachability_ = make_unique<Graph::ReachabilityIndex<double>>(graph_);
+    }
+    {
+        Profile::PhaseTimer timer("build_router");
+        BuildRouter();
+    }
+    if(options_.route_cache_capacity != 0){
+        route_cache_ = make_unique<RouteCache>(options_.route_cache_capacity);
+    }
+    ReportStats();
 }
 
-void TransportSystem::AddBusToGraph(const string& bus_name,const BusManager::BusInfo& bus_info){
-    const auto routing_settings = bus_base_ptr_->GetRouteSettings();
-    for(size_t start_idx = 0; start_idx < bus_info.stops_sequence.size(); start_idx++){
-        double travel_time = 0.0;
-        int spant_count = 0;
-        for(size_t end_idx = start_idx + 1; end_idx < bus_info.stops_sequence.size(); end_idx++){
-            const auto& from_stop = bus_info.stops_sequence[end_idx-1];
-            const auto& to_stop = bus_info.stops_sequence[end_idx];
-            
-            double distance = stops_base_ptr_->GetDistance(from_stop,to_stop);
-            double segment_travel_time = distance / routing_settings.bus_velocity;
-            travel_time += segment_travel_time;
-            spant_count++;
-            double total_time = routing_settings.bus_wait_time + travel_time;
+void TransportSystem::ReportStats() const{
+    if(!Profile::IsEnabled()){
+        return;
+    }
+    Profile::SetCounter("graph.vertices",graph_.GetVertexCount());
+    Profile::SetCounter("graph.edges",graph_.GetEdgeCount());
+    Profile::SetCounter("graph.edge_info_entries",edge_info_.size());
+    if(reachability_){
+        Profile::SetCounter("graph.strong_components",reachability_->GetComponentCount());
+        Profile::SetCounter("graph.reachability_bytes",reachability_->GetMemoryBytes());
+    }
+    if(router_){
+        Profile::SetCounter("router.all_pairs_table_bytes",router_->GetMemoryBytes());
+    }
+    if(hub_labels_){
+        Profile::SetCounter("router.hub_label_entries",hub_labels_->GetLabelEntryCount());
+        Profile::SetCounter("router.hub_labels_bytes",hub_labels_->GetMemoryBytes());
+    }
+    if(overlay_){
+        Profile::SetCounter("router.overlay_cells",overlay_->GetCellCount());
+        Profile::SetCounter("router.overlay_bytes",overlay_->GetMemoryBytes());
+    }
+    if(disk_router_){
+        Profile::SetCounter("router.disk_table_file_bytes",disk_router_->GetFileBytes());
+    }
+    Profile::SetCounter("router.memory_bytes",GetRouterMemoryBytes());
+}
 
-            Graph::VertexId from_v = stop_to_vertex_[bus_info.stops_sequence[start_idx]];
-            Graph::VertexId to_v = stop_to_vertex_[to_stop];
-            Graph::EdgeId edge_id  = graph_.AddEdge({from_v,to_v,total_time});
-            edge_info_[edge_id] = {bus_name,spant_count,travel_time};
+TransportSystem::BusEdges TransportSystem::MakeBusEdges(const string& bus_name,const BusManager::RoutePattern& pattern) const{
+    const auto& routing_settings = routing_settings_;
+    const size_t stop_count = pattern.GetStopCount();
+    vector<Graph::VertexId> vertices;
+    // segment_distances[idx] is the distance from stop idx-1 to stop idx
+    vector<double> segment_distances;
+    vertices.reserve(stop_count);
+    segment_distances.reserve(stop_count);
+    for(size_t idx = 0; idx < stop_count; idx++){
+        vertices.push_back(stop_id_to_vertex_[pattern.GetStopId(idx)]);
+        segment_distances.push_back(idx == 0 ? 0.0 : stops_base_ptr_->GetDistance(pattern.GetStopId(idx-1),pattern.GetStopId(idx)));
+    }
+
+    BusEdges bus_edges;
+    const size_t edge_count = stop_count * (stop_count - min<size_t>(stop_count,1)) / 2;
+    bus_edges.edges.reserve(edge_count);
+    bus_edges.edge_info.reserve(edge_count);
+    // Travel time is summed segment by segment, so the weights match a serial build bit for bit
+    for(size_t start_idx = 0; start_idx < stop_count; start_idx++){
+        double distance = 0.0;
+        double travel_time = 0.0;
+        for(size_t end_idx = start_idx + 1; end_idx < stop_count; end_idx++){
+            distance += segment_distances[end_idx];
+            travel_time += segment_distances[end_idx] / routing_settings.bus_velocity;
+            int span_count = end_idx - start_idx;
+            bus_edges.edges.push_back({vertices[start_idx],vertices[end_idx],routing_settings.bus_wait_time + travel_time});
+            bus_edges.edge_info.push_back({bus_name,span_count,distance,travel_time});
         }
     }
+    return bus_edges;
 }
 
 void TransportSystem::BuildGraph(){
     Graph::VertexId vertex_id = 0;
-    Graph::DirectedWeightedGraph<double> graph(stops_base_ptr_->GetDataSize());
-    for(const auto& it : *stops_base_ptr_){
-        stop_to_vertex_[it.first] = vertex_id;
-        vertex_to_stop_[vertex_id] = it.first;
+    stop_id_to_vertex_.resize(stops_base_ptr_->GetDataSize());
+    vertex_to_stop_.reserve(stops_base_ptr_->GetDataSize());
+    for(const auto* stop : OrderStops(*stops_base_ptr_,*bus_base_ptr_,options_.vertex_order)){
+        stop_to_vertex_[*stop] = vertex_id;
+        vertex_to_stop_.push_back(*stop);
+        stop_id_to_vertex_[*stops_base_ptr_->GetStopId(*stop)] = vertex_id;
         vertex_id++;
     }
+    if(options_.vertex_order != VertexOrder::Hash){
+        vertex_ranks_.resize(vertex_to_stop_.size());
+        size_t rank = 0;
+        for(const auto& it : *stops_base_ptr_){
+            vertex_ranks_[stop_to_vertex_.at(it.first)] = rank++;
+        }
+    }
 
+    auto bus_edges = MakeGraphEdges();
+    size_t edge_count = 0;
+    for(const auto& edges : bus_edges){
+        edge_count += edges.edges.size();
+    }
+    edge_info_.reserve(edge_count);
+    for(auto& edges : bus_edges){
+        for(size_t idx = 0; idx < edges.edges.size(); idx++){
+            graph_.AddEdge(edges.edges[idx]);
+            edge_info_.push_back(move(edges.edge_info[idx]));
+        }
+        edges = {};
+    }
+}
+
+vector<TransportSystem::BusEdges> TransportSystem::MakeGraphEdges() const{
+    // Buses sharing a pattern would add identical parallel edges; only the first of them
+    // (in iteration order) gets edges, which is also the one the routers would pick on a tie.
+    vector<const pair<const string,size_t>*> buses;
+    vector<bool> has_edges(bus_base_ptr_->GetPatternCount(),false);
     for(const auto& it : *bus_base_ptr_){
-        AddBusToGraph(it.first,it.second);
+        if(!has_edges[it.second]){
+            has_edges[it.second] = true;
+            buses.push_back(&it);
+        }
     }
-    
+    vector<BusEdges> bus_edges(buses.size());
+    ParallelFor(buses.size(),[this,&buses,&bus_edges](size_t idx){
+        bus_edges[idx] = MakeBusEdges(buses[idx]->first,bus_base_ptr_->GetPattern(buses[idx]->second));
+    });
+    return bus_edges;
+}
+
+void TransportSystem::SetRoutingSettings(const BusManager::RouteSettings& routing_settings){
+    if(routing_settings == routing_settings_){
+        return;
+    }
+    routing_settings_ = routing_settings;
+    vector<Graph::EdgeId> changed_edges;
+    {
+        Profile::PhaseTimer timer("update_weights");
+        Graph::EdgeId edge_id = 0;
+        for(auto& edges : MakeGraphEdges()){
+            for(size_t idx = 0; idx < edges.edges.size(); idx++, edge_id++){
+                if(graph_.GetEdge(edge_id).weight != edges.edges[idx].weight){
+                    graph_.UpdateEdgeWeight(edge_id,edges.edges[idx].weight);
+                    changed_edges.push_back(edge_id);
+                }
+                edge_info_[edge_id] = move(edges.edge_info[idx]);
+            }
+        }
+    }
+    {
+        // Reachability depends only on the edge ends, so it stays valid
+        Profile::PhaseTimer timer("build_router");
+        if(overlay_){
+            overlay_->Customize(changed_edges);
+        }
+        else{
+            router_.reset();
+            hub_labels_.reset();
+            disk_router_.reset();
+            source_tree_router_.reset();
+            BuildRouter();
+        }
+    }
+    InvalidateRouteCache();
 }
 
 void TransportSystem::BuildRouter(){
-    router_ = make_unique<Graph::Router<double>>(graph_);
+    switch(options_.engine){
+    case RouterEngine::None:
+        break;
+    case RouterEngine::AllPairs:
+        router_ = make_unique<Graph::Router<double>>(graph_,vertex_ranks_);
+        break;
+    case RouterEngine::HubLabels:
+        BuildHubLabels();
+        break;
+    case RouterEngine::Overlay:
+        overlay_ = make_unique<Graph::OverlayRouter<double>>(graph_,options_.overlay_cell_size,vertex_ranks_);
+        break;
+    case RouterEngine::Disk:
+        BuildDiskRouter();
+        break;
+    case RouterEngine::CachedDijkstra:
+        source_tree_router_ = make_unique<Graph::SourceTreeRouter<double>>(graph_,options_.tree_cache_size,vertex_ranks_);
+        break;
+    case RouterEngine::Auto:
+        BuildAutoRouter();
+        break;
+    }
+}
+
+namespace {
+
+struct EngineEstimate{
+    RouterEngine engine;
+    double memory_bytes;
+    double build_ms;
+    double query_us;
+};
+
+const char* GetEngineName(RouterEngine engine){
+    switch(engine){
+    case RouterEngine::AllPairs: return "all_pairs";
+    case RouterEngine::HubLabels: return "hub_labels";
+    case RouterEngine::CachedDijkstra: return "cached_dijkstra";
+    case RouterEngine::Overlay: return "overlay";
+    case RouterEngine::Disk: return "disk";
+    case RouterEngine::None: return "none";
+    case RouterEngine::Auto: return "auto";
+    }
+    return "unknown";
+}
+
+// Rough cost model of the candidates, calibrated on optimized builds of synthetic cities.
+vector<EngineEstimate> EstimateEngines(size_t vertex_count,size_t edge_count,const RoutingOptions& options){
+    const double vertices = max<size_t>(vertex_count,1);
+    const double edges = edge_count;
+    const double degree = edges / vertices;
+    const double log_vertices = log2(vertices + 1);
+    const double queries = options.expected_route_queries;
+
+    // V^2 table of (weight, previous edge) built by V^3 relaxations
+    const EngineEstimate all_pairs{RouterEngine::AllPairs,vertices * vertices * 32,vertices * vertices * vertices * 1.5e-6,2.0};
+
+    // Pruned labels grow roughly with sqrt(V) on transit graphs
+    const double label_size = min(vertices,8 * sqrt(vertices));
+    const EngineEstimate hub_labels{RouterEngine::HubLabels,2 * vertices * label_size * 24,
+        vertices * label_size * degree * log_vertices * 2e-5,2 * label_size * 0.003 + 2.0};
+
+    // Every source missing from the tree cache costs one full Dijkstra
+    const double tree_cache = min<double>(vertices,options.tree_cache_size);
+    const double dijkstra_us = (vertices + edges) * log_vertices * 0.02;
+    const double distinct_sources = min(vertices,queries);
+    const double miss_ratio = queries == 0 ? 1.0 : min(1.0,(distinct_sources + max(0.0,queries - distinct_sources) * (1 - tree_cache / vertices)) / queries);
+    const EngineEstimate cached_dijkstra{RouterEngine::CachedDijkstra,tree_cache * vertices * (sizeof(optional<double>) + sizeof(Graph::EdgeId)),0.0,miss_ratio * dijkstra_us + 1.0};
+
+    return {all_pairs,hub_labels,cached_dijkstra};
+}
+
+// Cheapest total time (build + expected queries) among the engines that fit the memory budget and
+// meet the latency target; without such an engine the fastest one that fits, then the smallest one.
+EngineEstimate ChooseEngine(const vector<EngineEstimate>& candidates,const RoutingOptions& options){
+    auto fits_memory = [&options](const EngineEstimate& estimate){
+        return options.memory_budget_bytes == 0 || estimate.memory_bytes <= options.memory_budget_bytes;
+    };
+    auto meets_latency = [&options](const EngineEstimate& estimate){
+        return options.latency_target_us == 0 || estimate.query_us <= options.latency_target_us;
+    };
+    auto total_ms = [&options](const EngineEstimate& estimate){
+        return estimate.build_ms + options.expected_route_queries * estimate.query_us / 1000;
+    };
+    const EngineEstimate* best = nullptr;
+    for(const auto& estimate : candidates){
+        if(fits_memory(estimate) && meets_latency(estimate) && (!best || total_ms(estimate) < total_ms(*best))){
+            best = &estimate;
+        }
+    }
+    for(const auto& estimate : candidates){
+        if(!best && fits_memory(estimate)){
+            best = &estimate;
+        }
+        else if(best && !meets_latency(*best) && fits_memory(estimate) && estimate.query_us < best->query_us){
+            best = &estimate;
+        }
+    }
+    if(!best){
+        best = &*min_element(candidates.begin(),candidates.end(),[](const auto& lhs,const auto& rhs){
+            return lhs.memory_bytes < rhs.memory_bytes;
+        });
+    }
+    return *best;
+}
+
+}
+
+void TransportSystem::BuildAutoRouter(){
+    // The tree cache is the only candidate that can shrink to any budget
+    const size_t tree_bytes = max<size_t>(graph_.GetVertexCount(),1) * (sizeof(optional<double>) + sizeof(Graph::EdgeId));
+    if(options_.memory_budget_bytes != 0){
+        options_.tree_cache_size = max<size_t>(1,min(options_.tree_cache_size,options_.memory_budget_bytes / tree_bytes));
+    }
+    const auto candidates = EstimateEngines(graph_.GetVertexCount(),graph_.GetEdgeCount(),options_);
+    const auto choice = ChooseEngine(candidates,options_);
+    options_.engine = choice.engine;
+    const auto start = chrono::steady_clock::now();
+    BuildRouter();
+    const double build_ms = chrono::duration<double,milli>(chrono::steady_clock::now() - start).count();
+
+    cerr << "{\"router_decision\": \"" << GetEngineName(choice.engine) << "\""
+         << ", \"vertices\": " << graph_.GetVertexCount()
+         << ", \"edges\": " << graph_.GetEdgeCount()
+         << ", \"average_degree\": " << static_cast<double>(graph_.GetEdgeCount()) / max<size_t>(graph_.GetVertexCount(),1)
+         << ", \"route_queries\": " << options_.expected_route_queries
+         << ", \"memory_budget_bytes\": " << options_.memory_budget_bytes
+         << ", \"latency_target_us\": " << options_.latency_target_us
+         << ", \"candidates\": [";
+    for(size_t idx = 0; idx < candidates.size(); idx++){
+        const auto& estimate = candidates[idx];
+        cerr << (idx ? ", " : "") << "{\"engine\": \"" << GetEngineName(estimate.engine) << "\""
+             << ", \"memory_bytes\": " << static_cast<uint64_t>(estimate.memory_bytes)
+             << ", \"build_ms\": " << estimate.build_ms
+             << ", \"query_us\": " << estimate.query_us << "}";
+    }
+    cerr << "], \"actual_memory_bytes\": " << GetRouterMemoryBytes()
+         << ", \"actual_build_ms\": " << build_ms << "}" << endl;
+}
+
+size_t TransportSystem::GetRouterMemoryBytes() const{
+    if(router_){
+        return router_->GetMemoryBytes();
+    }
+    if(hub_labels_){
+        return hub_labels_->GetMemoryBytes();
+    }
+    if(overlay_){
+        return overlay_->GetMemoryBytes();
+    }
+    if(disk_router_){
+        return disk_router_->GetMemoryBytes();
+    }
+    if(source_tree_router_){
+        return source_tree_router_->GetMemoryBytes();
+    }
+    return 0;
+}
+
+namespace {
+
+// Saved indices are keyed by the graph fingerprint seeded with the settings its weights came from
+uint64_t GetSettingsSeed(const BusManager::RouteSettings& settings){
+    uint64_t wait_bits = 0, velocity_bits = 0;
+    memcpy(&wait_bits,&settings.bus_wait_time,sizeof(wait_bits));
+    memcpy(&velocity_bits,&settings.bus_velocity,sizeof(velocity_bits));
+    return wait_bits ^ (velocity_bits * 0x9E3779B97F4A7C15ULL);
+}
+
+}
+
+void TransportSystem::BuildDiskRouter(){
+    const uint64_t seed = GetSettingsSeed(routing_settings_);
+    const string& table_path = options_.disk_table_path;
+    if(!table_path.empty()){
+        if(ifstream(table_path)){
+            try{
+                disk_router_ = make_unique<Graph::DiskRouter<double>>(graph_,table_path,seed);
+                return;
+            }
+            catch(const runtime_error& error){
+                cerr << error.what() << ", rebuilding " << table_path << endl;
+            }
+        }
+        Graph::DiskRouter<double>::Build(graph_,table_path,seed,vertex_ranks_);
+        disk_router_ = make_unique<Graph::DiskRouter<double>>(graph_,table_path,seed);
+        return;
+    }
+    // The mapping outlives the unlinked temporary file
+    string path = "/tmp/transport_router_XXXXXX";
+    const int fd = mkstemp(path.data());
+    if(fd < 0){
+        throw runtime_error("disk router: cannot create a temporary file");
+    }
+    close(fd);
+    Graph::DiskRouter<double>::Build(graph_,path,seed,vertex_ranks_);
+    disk_router_ = make_unique<Graph::DiskRouter<double>>(graph_,path,seed);
+    unlink(path.c_str());
+}
+
+void TransportSystem::BuildHubLabels(){
+    const uint64_t seed = GetSettingsSeed(routing_settings_);
+    const string& path = options_.hub_labels_path;
+    if(!path.empty()){
+        ifstream input(path, ios::binary);
+        if(input){
+            try{
+                hub_labels_ = make_unique<Graph::HubLabels<double>>(graph_,input,seed);
+                return;
+            }
+            catch(const runtime_error& error){
+                cerr << error.what() << ", rebuilding " << path << endl;
+            }
+        }
+    }
+    hub_labels_ = make_unique<Graph::HubLabels<double>>(graph_,seed,vertex_ranks_);
+    if(!path.empty()){
+        ofstream output(path, ios::binary | ios::trunc);
+        SaveHubLabels(output);
+        output.close();
+        if(!output){
+            remove(path.c_str());
+            throw runtime_error("hub labels: cannot write " + path);
+        }
+    }
+}
+
+const Graph::DirectedWeightedGraph<double>& TransportSystem::GetGraph() const{
+    return graph_;
+}
+
+void TransportSystem::SaveHubLabels(ostream& output) const{
+    if(hub_labels_){
+        hub_labels_->Serialize(output);
+    }
+}
+
+template <typename RouteInfo>
+optional<RoutePath> MakeRoutePath(optional<RouteInfo> route_info){
+    if(!route_info){
+        return nullopt;
+    }
+    return RoutePath{route_info->weight,move(route_info->edges)};
+}
+
+optional<RoutePath> TransportSystem::BuildRoutePath(Graph::VertexId from,Graph::VertexId to,Graph::SearchStats* stats) const{
+    if(hub_labels_){
+        return MakeRoutePath(hub_labels_->BuildRoute(from,to,stats));
+    }
+    if(overlay_){
+        return MakeRoutePath(overlay_->BuildRoute(from,to,stats));
+    }
+    if(disk_router_){
+        return MakeRoutePath(disk_router_->BuildRoute(from,to,stats));
+    }
+    if(source_tree_router_){
+        return MakeRoutePath(source_tree_router_->BuildRoute(from,to,stats));
+    }
+    if(!router_){
+        return nullopt;
+    }
+    RoutePath route_path;
+    auto weight = router_->BuildRouteEdges(from,to,route_path.edges);
+    if(!weight){
+        return nullopt;
+    }
+    route_path.total_time = *weight;
+    if(stats){
+        stats->relaxed_edges += route_path.edges.size();
+    }
+    return route_path;
 }
 
-RouteResponse TransportSystem::ConvertRouteInfoToResponse(const Graph::Router<double>::RouteInfo& route_info) const {
+RouteResponse TransportSystem::ConvertRoutePathToResponse(const RoutePath& route_path,const BusManager::RouteSettings& routing_settings) const {
     RouteResponse response;
-    response.total_time = route_info.weight;
+    response.total_time = route_path.total_time;
     
-    if (route_info.edge_count == 0) return response;
+    if (route_path.edges.empty()) return response;
     
-    Graph::EdgeId first_edge_id = router_->GetRouteEdge(route_info.id, 0);
-    const auto& first_edge = graph_.GetEdge(first_edge_id);
+    const auto& first_edge = graph_.GetEdge(route_path.edges.front());
     
     response.items.push_back(StopResponce{
-        vertex_to_stop_.at(first_edge.from),
-        bus_base_ptr_->GetRouteSettings().bus_wait_time
+        vertex_to_stop_[first_edge.from],
+        routing_settings.bus_wait_time
     });
 
-    for (size_t i = 0; i < route_info.edge_count; ++i) {
-        Graph::EdgeId edge_id = router_->GetRouteEdge(route_info.id, i);
+    for (size_t i = 0; i < route_path.edges.size(); ++i) {
+        Graph::EdgeId edge_id = route_path.edges[i];
         const auto& edge = graph_.GetEdge(edge_id);
         const auto& info = edge_info_.at(edge_id);
         response.items.push_back(BusResponce{
             info.bus_name, 
             info.span_count, 
-            info.travel_time
+            routing_settings == routing_settings_ ? info.travel_time : info.distance / routing_settings.bus_velocity
         });
         
-        if (i < route_info.edge_count - 1) {
+        if (i + 1 < route_path.edges.size()) {
             response.items.push_back(StopResponce{
-                vertex_to_stop_.at(edge.to),
-                bus_base_ptr_->GetRouteSettings().bus_wait_time
+                vertex_to_stop_[edge.to],
+                routing_settings.bus_wait_time
             });
         }
     }
     return response;
 }
 
-optional<RouteResponse> TransportSystem::FindRoute(const string& from,const string& to) const {
-    if(!stop_to_vertex_.count(from) || !stop_to_vertex_.count(to)){
+optional<Graph::VertexId> TransportSystem::GetStopVertex(const string& stop_name) const{
+    auto it = stop_to_vertex_.find(stop_name);
+    if(it == stop_to_vertex_.end()){
         return nullopt;
     }
-    auto from_v = stop_to_vertex_.at(from);
-    auto to_v = stop_to_vertex_.at(to);
-    auto route_info = router_->BuildRoute(from_v,to_v);
-    if(!route_info){
+    return it->second;
+}
+
+optional<pair<Graph::VertexId,Graph::VertexId>> TransportSystem::FindReachableVertices(const string& from,const string& to) const{
+    auto from_it = stop_to_vertex_.find(from);
+    auto to_it = stop_to_vertex_.find(to);
+    if(from_it == stop_to_vertex_.end() || to_it == stop_to_vertex_.end()
+        || (reachability_ && !reachability_->CanReach(from_it->second,to_it->second))){
         return nullopt;
     }
-    return ConvertRouteInfoToResponse(*route_info);
+    return pair(from_it->second,to_it->second);
+}
+
+optional<RouteResponse> TransportSystem::FindRoute(const string& from,const string& to,Graph::SearchStats* stats) const {
+    const auto vertices = FindReachableVertices(from,to);
+    if(!vertices){
+        return nullopt;
+    }
+    auto route_path = BuildRoutePath(vertices->first,vertices->second,stats);
+    if(!route_path){
+        return nullopt;
+    }
+    return ConvertRoutePathToResponse(*route_path,routing_settings_);
+}
+
+shared_ptr<const RenderedRoute> TransportSystem::FindRenderedRoute(const string& from,const string& to,Graph::SearchStats* stats) const{
+    const auto vertices = FindReachableVertices(from,to);
+    if(!vertices){
+        return nullptr;
+    }
+    const auto [from_v,to_v] = *vertices;
+    if(route_cache_){
+        if(auto cached = route_cache_->Get(from_v,to_v)){
+            return *cached;
+        }
+    }
+    shared_ptr<const RenderedRoute> result;
+    if(auto route_path = BuildRoutePath(from_v,to_v,stats)){
+        result = RenderRoute(ConvertRoutePathToResponse(*route_path,routing_settings_));
+    }
+    if(route_cache_){
+        route_cache_->Put(from_v,to_v,result);
+    }
+    return result;
+}
+
+shared_ptr<const RenderedRoute> TransportSystem::FindRenderedRoute(const string& from,const string& to,
+    const BusManager::RouteSettings& routing_settings,Graph::SearchStats* stats) const{
+    if(routing_settings == routing_settings_){
+        return FindRenderedRoute(from,to,stats);
+    }
+    const auto vertices = FindReachableVertices(from,to);
+    if(!vertices){
+        return nullptr;
+    }
+    auto path = Graph::FindShortestPath(graph_,vertices->first,vertices->second,[this,&routing_settings](Graph::EdgeId edge_id){
+        return routing_settings.bus_wait_time + edge_info_[edge_id].distance / routing_settings.bus_velocity;
+    },stats,reachability_.get(),vertex_ranks_);
+    if(!path){
+        return nullptr;
+    }
+    return RenderRoute(ConvertRoutePathToResponse({path->weight,move(path->edges)},routing_settings));
+}
+
+shared_ptr<const RenderedRoute> TransportSystem::RenderRoute(const RouteResponse& response){
+    ostringstream items;
+    items << response.items;
+    return make_shared<RenderedRoute>(RenderedRoute{response.total_time,response.items.size(),items.str()});
+}
+
+void TransportSystem::InvalidateRouteCache(){
+    if(route_cache_){
+        route_cache_->Clear();
+    }
+}
+
+void TransportSystem::ReportRouteCacheStats() const{
+    if(!Profile::IsEnabled() || !route_cache_){
+        return;
+    }
+    Profile::SetCounter("route_cache.capacity",route_cache_->GetCapacity());
+    Profile::SetCounter("route_cache.hits",route_cache_->GetHitCount());
+    Profile::SetCounter("route_cache.misses",route_cache_->GetMissCount());
+    Profile::SetCounter("route_cache.evictions",route_cache_->GetEvictionCount());
 }
 
 ostream& operator << (ostream& out,const vector<variant<BusResponce,StopResponce>>& items){
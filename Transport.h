@@ -1,8 +1,18 @@
 #pragma once
 #include "graph.h"
 #include "router.h"
+#include "hub_labels.h"
+#include "overlay.h"
+#include "disk_router.h"
+#include "source_tree_router.h"
+#include "parallel.h"
 #include "StopsBase.h"
 #include "Bus.h"
+#include "VertexOrder.h"
+#include "Profile.h"
+#include "RouteCache.h"
+#include "dijkstra.h"
+#include "reachability.h"
 #include <iostream>
 #include <memory>
 #include <unordered_map>
@@ -28,9 +38,47 @@ struct RouteResponse{
     std::vector<std::variant<BusResponce,StopResponce>> items;
 };
 
+struct RoutePath{
+    double total_time = 0.0;
+    std::vector<Graph::EdgeId> edges;
+};
+
+enum class RouterEngine{
+    None,
+    AllPairs,
+    HubLabels,
+    Overlay,
+    Disk,
+    // Dijkstra per source with the shortest path trees kept in an LRU cache
+    CachedDijkstra,
+    // One of AllPairs, CachedDijkstra or HubLabels, chosen from the graph size and the budgets below
+    Auto
+};
+
+struct RoutingOptions{
+    RouterEngine engine = RouterEngine::AllPairs;
+    std::string hub_labels_path;
+    size_t overlay_cell_size = 0;
+    // All-pairs table file for RouterEngine::Disk; a temporary file is used when empty
+    std::string disk_table_path;
+    size_t tree_cache_size = Graph::SourceTreeRouter<double>::DEFAULT_TREE_CACHE_SIZE;
+    // Inputs of RouterEngine::Auto; 0 means no limit
+    size_t memory_budget_bytes = 0;
+    double latency_target_us = 0.0;
+    size_t expected_route_queries = 0;
+    VertexOrder vertex_order = VertexOrder::Hash;
+    // Rendered routes kept for repeated (from, to) pairs; 0 disables the cache
+    size_t route_cache_capacity = 0;
+    // Index answering unreachable pairs without a search; only the graph build benchmark turns it off
+    bool build_reachability = true;
+};
+
+// Edge weights are derived from routing settings: bus_wait_time + travel time.
 struct EdgeInfo {
     std::string bus_name;
     int span_count;
+    double distance;
+    // Sum of the segment times under the settings the graph was built for
     double travel_time;
 };
 
@@ -40,17 +88,62 @@ private:
     std::shared_ptr<StopManager> stops_base_ptr_;
     Graph::DirectedWeightedGraph<double> graph_;
     std::unordered_map<std::string, Graph::VertexId> stop_to_vertex_;
-    std::unordered_map<Graph::VertexId, std::string> vertex_to_stop_;
+    std::vector<std::string> vertex_to_stop_;
+    std::vector<Graph::VertexId> stop_id_to_vertex_;
+    // Position of every vertex in the default (hash) numbering; empty when that numbering is used.
+    // Routers resolve ties by it, so the vertex order does not change the routes printed.
+    Graph::VertexRanks vertex_ranks_;
+    RoutingOptions options_;
+    // Settings the edge weights and the router were built for
+    BusManager::RouteSettings routing_settings_;
     std::unique_ptr<Graph::Router<double>> router_;
-    std::unordered_map<Graph::EdgeId, EdgeInfo> edge_info_;
+    std::unique_ptr<Graph::HubLabels<double>> hub_labels_;
+    std::unique_ptr<Graph::OverlayRouter<double>> overlay_;
+    std::unique_ptr<Graph::DiskRouter<double>> disk_router_;
+    std::unique_ptr<Graph::SourceTreeRouter<double>> source_tree_router_;
+    std::vector<EdgeInfo> edge_info_;
+    std::unique_ptr<RouteCache> route_cache_;
+    std::unique_ptr<Graph::ReachabilityIndex<double>> reachability_;
 public:
-    TransportSystem(std::shared_ptr<BusManager> bus_base,std::shared_ptr<StopManager> stop_base);
-    std::optional<RouteResponse> FindRoute(const std::string& from,const std::string& to) const;
+    TransportSystem(std::shared_ptr<BusManager> bus_base,std::shared_ptr<StopManager> stop_base,
+        RoutingOptions options = {});
+    std::optional<RouteResponse> FindRoute(const std::string& from,const std::string& to,
+        Graph::SearchStats* stats = nullptr) const;
+    // Items rendered as in the Route response; nullptr when there is no route.
+    std::shared_ptr<const RenderedRoute> FindRenderedRoute(const std::string& from,const std::string& to,
+        Graph::SearchStats* stats = nullptr) const;
+    // Same for other routing settings: weights are computed on the fly by Dijkstra over the same graph,
+    // unless the settings match the ones the router was built for.
+    std::shared_ptr<const RenderedRoute> FindRenderedRoute(const std::string& from,const std::string& to,
+        const BusManager::RouteSettings& routing_settings,Graph::SearchStats* stats = nullptr) const;
+    // Recomputes the edge weights for other settings: the overlay re-customizes the cells whose edges
+    // changed, the other engines are rebuilt and cached routes are dropped. Must not run concurrently
+    // with queries; transport_replay --switch-settings checks it against a fresh build.
+    void SetRoutingSettings(const BusManager::RouteSettings& routing_settings);
+    void ReportRouteCacheStats() const;
+    void SaveHubLabels(std::ostream& output) const;
+    const Graph::DirectedWeightedGraph<double>& GetGraph() const;
+    std::optional<Graph::VertexId> GetStopVertex(const std::string& stop_name) const;
 private:
-    RouteResponse ConvertRouteInfoToResponse(const Graph::Router<double>::RouteInfo& route_info) const;
-    void AddBusToGraph(const std::string& bus_name,const BusManager::BusInfo& bus_info);
+    // Vertices of both stops when a route between them may exist
+    std::optional<std::pair<Graph::VertexId,Graph::VertexId>> FindReachableVertices(const std::string& from,const std::string& to) const;
+    std::optional<RoutePath> BuildRoutePath(Graph::VertexId from,Graph::VertexId to,Graph::SearchStats* stats) const;
+    RouteResponse ConvertRoutePathToResponse(const RoutePath& route_path,const BusManager::RouteSettings& routing_settings) const;
+    static std::shared_ptr<const RenderedRoute> RenderRoute(const RouteResponse& response);
+    struct BusEdges{
+        std::vector<Graph::Edge<double>> edges;
+        std::vector<EdgeInfo> edge_info;
+    };
+    BusEdges MakeBusEdges(const std::string& bus_name,const BusManager::RoutePattern& pattern) const;
+    std::vector<BusEdges> MakeGraphEdges() const;
     void BuildGraph();
     void BuildRouter();
+    void BuildHubLabels();
+    void BuildDiskRouter();
+    void BuildAutoRouter();
+    size_t GetRouterMemoryBytes() const;
+    void InvalidateRouteCache();
+    void ReportStats() const;
 };
 
 
@@ -0,0 +1,197 @@
+#include "VertexOrder.h"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+vector<const string*> CollectStops(const StopManager& stops_base){
+    vector<const string*> stops;
+    stops.reserve(stops_base.GetDataSize());
+    for(const auto& it : stops_base){
+        stops.push_back(&it.first);
+    }
+    return stops;
+}
+
+vector<const pair<const string,size_t>*> CollectBusesByName(const BusManager& bus_base){
+    vector<const pair<const string,size_t>*> buses;
+    for(const auto& it : bus_base){
+        buses.push_back(&it);
+    }
+    sort(buses.begin(),buses.end(),[](const auto* lhs,const auto* rhs){
+        return lhs->first < rhs->first;
+    });
+    return buses;
+}
+
+vector<const string*> OrderByBusRoutes(const StopManager& stops_base,const BusManager& bus_base){
+    vector<const string*> stops = CollectStops(stops_base);
+    unordered_map<string_view,size_t> position;
+    for(size_t idx = 0; idx < stops.size(); idx++){
+        position[*stops[idx]] = idx;
+    }
+    vector<bool> visited(stops.size(),false);
+    vector<const string*> result;
+    result.reserve(stops.size());
+    for(const auto* bus : CollectBusesByName(bus_base)){
+        for(const size_t stop_id : bus_base.GetPattern(bus->second).stop_ids){
+            const size_t idx = position.at(stops_base.GetStopName(stop_id));
+            if(!visited[idx]){
+                visited[idx] = true;
+                result.push_back(stops[idx]);
+            }
+        }
+    }
+    vector<const string*> rest;
+    for(size_t idx = 0; idx < stops.size(); idx++){
+        if(!visited[idx]){
+            rest.push_back(stops[idx]);
+        }
+    }
+    sort(rest.begin(),rest.end(),[](const string* lhs,const string* rhs){
+        return *lhs < *rhs;
+    });
+    result.insert(result.end(),rest.begin(),rest.end());
+    return result;
+}
+
+// Reverse Cuthill-McKee over the undirected graph of consecutive stops on every bus.
+vector<const string*> OrderByRcm(const StopManager& stops_base,const BusManager& bus_base){
+    vector<const string*> stops = OrderByBusRoutes(stops_base,bus_base);
+    unordered_map<string_view,size_t> position;
+    for(size_t idx = 0; idx < stops.size(); idx++){
+        position[*stops[idx]] = idx;
+    }
+    vector<vector<size_t>> neighbours(stops.size());
+    for(const auto* bus : CollectBusesByName(bus_base)){
+        const auto& pattern = bus_base.GetPattern(bus->second);
+        for(size_t idx = 1; idx < pattern.GetStopCount(); idx++){
+            const size_t from = position.at(stops_base.GetStopName(pattern.GetStopId(idx-1)));
+            const size_t to = position.at(stops_base.GetStopName(pattern.GetStopId(idx)));
+            if(from != to){
+                neighbours[from].push_back(to);
+                neighbours[to].push_back(from);
+            }
+        }
+    }
+    for(auto& list : neighbours){
+        sort(list.begin(),list.end());
+        list.erase(unique(list.begin(),list.end()),list.end());
+    }
+
+    vector<size_t> by_degree(stops.size());
+    iota(by_degree.begin(),by_degree.end(),0);
+    stable_sort(by_degree.begin(),by_degree.end(),[&neighbours](size_t lhs,size_t rhs){
+        return neighbours[lhs].size() < neighbours[rhs].size();
+    });
+
+    vector<bool> visited(stops.size(),false);
+    vector<size_t> order;
+    order.reserve(stops.size());
+    for(size_t start : by_degree){
+        if(visited[start]){
+            continue;
+        }
+        visited[start] = true;
+        deque<size_t> queue{start};
+        while(!queue.empty()){
+            const size_t current = queue.front();
+            queue.pop_front();
+            order.push_back(current);
+            vector<size_t> next;
+            for(size_t neighbour : neighbours[current]){
+                if(!visited[neighbour]){
+                    visited[neighbour] = true;
+                    next.push_back(neighbour);
+                }
+            }
+            stable_sort(next.begin(),next.end(),[&neighbours](size_t lhs,size_t rhs){
+                return neighbours[lhs].size() < neighbours[rhs].size();
+            });
+            queue.insert(queue.end(),next.begin(),next.end());
+        }
+    }
+
+    vector<const string*> result;
+    result.reserve(stops.size());
+    for(auto it = order.rbegin(); it != order.rend(); it++){
+        result.push_back(stops[*it]);
+    }
+    return result;
+}
+
+uint64_t HilbertIndex(uint32_t x,uint32_t y,uint32_t side){
+    uint64_t index = 0;
+    for(uint32_t half = side / 2; half > 0; half /= 2){
+        const uint32_t rx = (x & half) ? 1 : 0;
+        const uint32_t ry = (y & half) ? 1 : 0;
+        index += static_cast<uint64_t>(half) * half * ((3 * rx) ^ ry);
+        if(ry == 0){
+            if(rx == 1){
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            swap(x,y);
+        }
+    }
+    return index;
+}
+
+vector<const string*> OrderByHilbertCurve(const StopManager& stops_base){
+    vector<const string*> stops = CollectStops(stops_base);
+    if(stops.empty()){
+        return stops;
+    }
+    double min_lat = stops_base.GetStopInfo(*stops[0]).coordinates.latitude, max_lat = min_lat;
+    double min_lon = stops_base.GetStopInfo(*stops[0]).coordinates.longitude, max_lon = min_lon;
+    for(const auto* stop : stops){
+        const auto& coordinates = stops_base.GetStopInfo(*stop).coordinates;
+        min_lat = min(min_lat,coordinates.latitude);
+        max_lat = max(max_lat,coordinates.latitude);
+        min_lon = min(min_lon,coordinates.longitude);
+        max_lon = max(max_lon,coordinates.longitude);
+    }
+
+    const uint32_t side = 1u << 16;
+    auto to_grid = [side](double value,double min_value,double max_value){
+        if(max_value <= min_value){
+            return 0u;
+        }
+        return static_cast<uint32_t>((value - min_value) / (max_value - min_value) * (side - 1));
+    };
+    vector<pair<uint64_t,const string*>> keyed;
+    keyed.reserve(stops.size());
+    for(const auto* stop : stops){
+        const auto& coordinates = stops_base.GetStopInfo(*stop).coordinates;
+        keyed.push_back({HilbertIndex(to_grid(coordinates.longitude,min_lon,max_lon),
+            to_grid(coordinates.latitude,min_lat,max_lat),side),stop});
+    }
+    sort(keyed.begin(),keyed.end(),[](const auto& lhs,const auto& rhs){
+        return tie(lhs.first,*lhs.second) < tie(rhs.first,*rhs.second);
+    });
+    for(size_t idx = 0; idx < keyed.size(); idx++){
+        stops[idx] = keyed[idx].second;
+    }
+    return stops;
+}
+
+}
+
+vector<const string*> OrderStops(const StopManager& stops_base,const BusManager& bus_base,VertexOrder order){
+    switch(order){
+    case VertexOrder::BusRoute:
+        return OrderByBusRoutes(stops_base,bus_base);
+    case VertexOrder::Rcm:
+        return OrderByRcm(stops_base,bus_base);
+    case VertexOrder::Hilbert:
+        return OrderByHilbertCurve(stops_base);
+    case VertexOrder::Hash:
+        break;
+    }
+    return CollectStops(stops_base);
+}
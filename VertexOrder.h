@@ -0,0 +1,14 @@
+#pragma once
+#include "StopsBase.h"
+#include "Bus.h"
+#include <string>
+#include <vector>
+
+enum class VertexOrder{
+    Hash,
+    BusRoute,
+    Rcm,
+    Hilbert
+};
+
+std::vector<const std::string*> OrderStops(const StopManager& stops_base,const BusManager& bus_base,VertexOrder order);
@@ -0,0 +1,204 @@
+#include "CityGenerator.h"
+#include "Requests.h"
+#include "Transport.h"
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+CityParams MakeCityParams(size_t stop_count){
+    CityParams params;
+    params.seed = 42;
+    params.stop_count = stop_count;
+    params.bus_count = max<size_t>(stop_count / 5,1);
+    params.route_length = 12;
+    params.roundtrip_ratio = 0.5;
+    params.distance_density = 1.0;
+    params.stop_requests = stop_count;
+    params.bus_requests = stop_count;
+    params.route_requests = stop_count;
+    return params;
+}
+
+const string& CityInput(size_t stop_count){
+    static map<size_t,string> cache;
+    auto it = cache.find(stop_count);
+    if(it == cache.end()){
+        it = cache.emplace(stop_count,GenerateCity(MakeCityParams(stop_count))).first;
+    }
+    return it->second;
+}
+
+Json::Document LoadCity(size_t stop_count){
+    istringstream input(CityInput(stop_count));
+    return Json::Load(input);
+}
+
+const RouterEngine Engines[] = {RouterEngine::AllPairs,RouterEngine::HubLabels,RouterEngine::Overlay};
+const char* const Engine_Names[] = {"all_pairs","hub_labels","overlay"};
+
+RoutingOptions MakeRoutingOptions(RouterEngine engine){
+    RoutingOptions options;
+    options.engine = engine;
+    return options;
+}
+
+vector<pair<string,string>> MakeRoutePairs(size_t stop_count,size_t distinct_pairs){
+    mt19937_64 random(7);
+    uniform_int_distribution<size_t> any_stop(0,stop_count - 1);
+    vector<pair<string,string>> pairs;
+    for(size_t idx = 0; idx < distinct_pairs; idx++){
+        pairs.push_back({"Stop " + to_string(any_stop(random)),"Stop " + to_string(any_stop(random))});
+    }
+    return pairs;
+}
+
+void BM_JsonLoad(benchmark::State& state){
+    const auto& input = CityInput(state.range(0));
+    for(auto _ : state){
+        istringstream stream(input);
+        auto document = Json::Load(stream);
+        benchmark::DoNotOptimize(document);
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+
+void BM_ProcessInput(benchmark::State& state){
+    const auto document = LoadCity(state.range(0));
+    for(auto _ : state){
+        auto result = ProcessInput(document);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+void BM_BuildGraph(benchmark::State& state){
+    const auto document = LoadCity(state.range(0));
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    auto options = MakeRoutingOptions(RouterEngine::None);
+    options.build_reachability = false;
+    for(auto _ : state){
+        TransportSystem transport_system(bus_base,stops_base,options);
+        benchmark::DoNotOptimize(transport_system);
+    }
+}
+
+void BM_BuildReachability(benchmark::State& state){
+    const auto document = LoadCity(state.range(0));
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    auto options = MakeRoutingOptions(RouterEngine::None);
+    options.build_reachability = false;
+    TransportSystem graph_only(bus_base,stops_base,options);
+    for(auto _ : state){
+        Graph::ReachabilityIndex<double> reachability(graph_only.GetGraph());
+        benchmark::DoNotOptimize(reachability);
+    }
+}
+
+void BM_RouterBuild(benchmark::State& state){
+    const auto document = LoadCity(state.range(0));
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    const RouterEngine engine = Engines[state.range(1)];
+    state.SetLabel(Engine_Names[state.range(1)]);
+    TransportSystem graph_only(bus_base,stops_base,MakeRoutingOptions(RouterEngine::None));
+    for(auto _ : state){
+        switch(engine){
+        case RouterEngine::AllPairs:{
+            Graph::Router<double> router(graph_only.GetGraph());
+            benchmark::DoNotOptimize(router);
+            break;
+        }
+        case RouterEngine::HubLabels:{
+            Graph::HubLabels<double> hub_labels(graph_only.GetGraph());
+            benchmark::DoNotOptimize(hub_labels);
+            break;
+        }
+        default:{
+            Graph::OverlayRouter<double> overlay(graph_only.GetGraph());
+            benchmark::DoNotOptimize(overlay);
+            break;
+        }
+        }
+    }
+}
+
+void RunFindRoute(benchmark::State& state,size_t distinct_pairs){
+    const auto document = LoadCity(state.range(0));
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    state.SetLabel(Engine_Names[state.range(1)]);
+    TransportSystem transport_system(bus_base,stops_base,MakeRoutingOptions(Engines[state.range(1)]));
+    const auto pairs = MakeRoutePairs(state.range(0),distinct_pairs);
+    size_t idx = 0;
+    for(auto _ : state){
+        const auto& [from,to] = pairs[idx];
+        auto response = transport_system.FindRoute(from,to);
+        benchmark::DoNotOptimize(response);
+        idx = idx + 1 == pairs.size() ? 0 : idx + 1;
+    }
+}
+
+void BM_FindRouteRandom(benchmark::State& state){
+    RunFindRoute(state,4096);
+}
+
+void BM_FindRouteRepeated(benchmark::State& state){
+    RunFindRoute(state,8);
+}
+
+void BM_PrintResult(benchmark::State& state){
+    const auto document = LoadCity(state.range(0));
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    TransportSystem transport_system(bus_base,stops_base,MakeRoutingOptions(RouterEngine::HubLabels));
+    for(auto _ : state){
+        ostringstream output;
+        PrintResult(stats_request,stops_base,bus_base,transport_system,output);
+        benchmark::DoNotOptimize(output);
+    }
+    state.SetItemsProcessed(state.iterations() * stats_request.size());
+}
+
+void EngineArgs(benchmark::internal::Benchmark* benchmark){
+    for(int64_t stop_count : {100,400}){
+        for(int64_t engine = 0; engine < 3; engine++){
+            benchmark->Args({stop_count,engine});
+        }
+    }
+}
+
+}
+
+BENCHMARK(BM_JsonLoad)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ProcessInput)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BuildGraph)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BuildReachability)->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RouterBuild)->Apply(EngineArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FindRouteRandom)->Apply(EngineArgs);
+BENCHMARK(BM_FindRouteRepeated)->Apply(EngineArgs);
+BENCHMARK(BM_PrintResult)->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// Reports JSON unless another --benchmark_format is requested explicitly.
+int main(int argc, char* argv[]){
+    vector<char*> args(argv,argv + argc);
+    char json_format[] = "--benchmark_format=json";
+    bool has_format = false;
+    for(int i = 1; i < argc; i++){
+        has_format = has_format || strncmp(argv[i],"--benchmark_format=",19) == 0;
+    }
+    if(!has_format){
+        args.push_back(json_format);
+    }
+    int args_count = args.size();
+    benchmark::Initialize(&args_count,args.data());
+    if(benchmark::ReportUnrecognizedArguments(args_count,args.data())){
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "graph.h"
+#include "reachability.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  template <typename Weight>
+  struct PathInfo {
+    Weight weight;
+    std::vector<EdgeId> edges;
+  };
+
+  constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+  // Queue of (weight, rank, vertex): equal weights are popped in rank order
+  template <typename Weight>
+  using SearchQueue = std::priority_queue<std::tuple<Weight, size_t, VertexId>,
+                                          std::vector<std::tuple<Weight, size_t, VertexId>>,
+                                          std::greater<std::tuple<Weight, size_t, VertexId>>>;
+
+  // Full single-source Dijkstra: distances and the last edge of a shortest path to every vertex
+  // (NO_EDGE for the source and unreachable vertices). Buffers are resized to the vertex count.
+  template <typename Weight>
+  void ComputeShortestPathTree(const DirectedWeightedGraph<Weight>& graph, VertexId source,
+                               std::vector<std::optional<Weight>>& distances, std::vector<EdgeId>& parent_edges,
+                               SearchStats* stats = nullptr, const VertexRanks& ranks = {}) {
+    distances.assign(graph.GetVertexCount(), std::nullopt);
+    parent_edges.assign(graph.GetVertexCount(), NO_EDGE);
+    SearchQueue<Weight> queue;
+    distances[source] = 0;
+    queue.push({0, GetVertexRank(ranks, source), source});
+    SearchStats local_stats;
+    while (!queue.empty()) {
+      const Weight weight = std::get<0>(queue.top());
+      const VertexId vertex = std::get<2>(queue.top());
+      queue.pop();
+      if (weight > *distances[vertex]) {
+        continue;
+      }
+      ++local_stats.settled_vertices;
+      for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+        const auto& edge = graph.GetEdge(edge_id);
+        const Weight candidate = weight + edge.weight;
+        ++local_stats.relaxed_edges;
+        if (!distances[edge.to] || candidate < *distances[edge.to]) {
+          distances[edge.to] = candidate;
+          parent_edges[edge.to] = edge_id;
+          queue.push({candidate, GetVertexRank(ranks, edge.to), edge.to});
+        }
+      }
+    }
+    parent_edges[source] = NO_EDGE;
+    if (stats) {
+      stats->settled_vertices += local_stats.settled_vertices;
+      stats->relaxed_edges += local_stats.relaxed_edges;
+    }
+  }
+
+  // Single-pair Dijkstra with edge weights supplied by the caller, for queries whose weights
+  // differ from the ones stored in the graph. edge_weight(edge_id) must be non-negative.
+  // With a reachability index the search skips vertices that cannot reach the target.
+  template <typename Weight, typename EdgeWeight>
+  std::optional<PathInfo<Weight>> FindShortestPath(const DirectedWeightedGraph<Weight>& graph,
+                                                   VertexId from, VertexId to, EdgeWeight edge_weight,
+                                                   SearchStats* stats = nullptr,
+                                                   const ReachabilityIndex<Weight>* reachability = nullptr,
+                                                   const VertexRanks& ranks = {}) {
+    if (reachability && !reachability->CanReach(from, to)) {
+      return std::nullopt;
+    }
+    std::vector<std::optional<Weight>> distances(graph.GetVertexCount());
+    std::vector<EdgeId> parent_edges(graph.GetVertexCount(), NO_EDGE);
+
+    SearchQueue<Weight> queue;
+    distances[from] = 0;
+    queue.push({0, GetVertexRank(ranks, from), from});
+
+    SearchStats local_stats;
+    while (!queue.empty()) {
+      const Weight weight = std::get<0>(queue.top());
+      const VertexId vertex = std::get<2>(queue.top());
+      queue.pop();
+      if (weight > *distances[vertex]) {
+        continue;
+      }
+      ++local_stats.settled_vertices;
+      if (vertex == to) {
+        break;
+      }
+      for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+        const VertexId next = graph.GetEdge(edge_id).to;
+        if (reachability && !reachability->CanReach(next, to)) {
+          continue;
+        }
+        const Weight candidate = weight + edge_weight(edge_id);
+        ++local_stats.relaxed_edges;
+        if (!distances[next] || candidate < *distances[next]) {
+          distances[next] = candidate;
+          parent_edges[next] = edge_id;
+          queue.push({candidate, GetVertexRank(ranks, next), next});
+        }
+      }
+    }
+
+    if (stats) {
+      stats->settled_vertices += local_stats.settled_vertices;
+      stats->relaxed_edges += local_stats.relaxed_edges;
+    }
+    if (!distances[to]) {
+      return std::nullopt;
+    }
+    PathInfo<Weight> path{*distances[to], {}};
+    for (VertexId vertex = to; vertex != from; vertex = graph.GetEdge(parent_edges[vertex]).from) {
+      path.edges.push_back(parent_edges[vertex]);
+    }
+    std::reverse(path.edges.begin(), path.edges.end());
+    return path;
+  }
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "dijkstra.h"
+#include "graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Graph {
+
+  // All-pairs routes kept in a file instead of memory. Row `from` holds the last edge of
+  // the shortest path from `from` to every vertex, varint-coded as edge id + 1, after a table
+  // with the byte offset of every CHECKPOINT_STRIDE-th entry; rows are computed by Dijkstra
+  // in parallel batches. Queries map the file and decode at most CHECKPOINT_STRIDE varints
+  // per path edge, so nothing but the mapping stays in memory.
+  // The header stores a fingerprint of the weights and of the seed (the routing settings
+  // the weights were derived from); opening a file built for another fingerprint throws.
+  template <typename Weight>
+  class DiskRouter {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    // Computes the table and writes it to path; ranks decide between equal-weight routes
+    static void Build(const Graph& graph, const std::string& path, uint64_t seed = 0, const VertexRanks& ranks = {});
+
+    DiskRouter(const Graph& graph, const std::string& path, uint64_t seed = 0);
+    ~DiskRouter();
+    DiskRouter(const DiskRouter&) = delete;
+    DiskRouter& operator=(const DiskRouter&) = delete;
+
+    struct RouteInfo {
+      Weight weight;
+      std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    size_t GetFileBytes() const;
+    size_t GetMemoryBytes() const;
+
+  private:
+    static constexpr uint64_t MAGIC = 0x324241544B534944ULL;
+    static constexpr size_t HEADER_SIZE = 4 * sizeof(uint64_t);
+    static constexpr size_t CHECKPOINT_STRIDE = 64;
+    // Encoded rows buffered by Build before they are written out
+    static constexpr size_t BUILD_BUFFER_BYTES = size_t{64} << 20;
+
+    const Graph& graph_;
+    const unsigned char* data_ = nullptr;
+    size_t file_size_ = 0;
+
+    static size_t GetCheckpointCount(size_t vertex_count);
+    // 0 means "no edge": the target is the source itself or unreachable
+    static void EncodeRow(const std::vector<EdgeId>& last_edges, std::string& output);
+
+    uint64_t GetRowOffset(VertexId vertex) const;
+    uint64_t GetEntry(VertexId from, VertexId to) const;
+  };
+
+
+  template <typename Weight>
+  size_t DiskRouter<Weight>::GetCheckpointCount(size_t vertex_count) {
+    return (vertex_count + CHECKPOINT_STRIDE - 1) / CHECKPOINT_STRIDE;
+  }
+
+  template <typename Weight>
+  void DiskRouter<Weight>::EncodeRow(const std::vector<EdgeId>& last_edges, std::string& output) {
+    const size_t row_begin = output.size();
+    output.resize(row_begin + GetCheckpointCount(last_edges.size()) * sizeof(uint32_t));
+    for (size_t index = 0; index < last_edges.size(); ++index) {
+      if (index % CHECKPOINT_STRIDE == 0) {
+        const uint32_t checkpoint = output.size() - row_begin;
+        std::memcpy(output.data() + row_begin + index / CHECKPOINT_STRIDE * sizeof(uint32_t), &checkpoint, sizeof(checkpoint));
+      }
+      uint64_t value = last_edges[index] == NO_EDGE ? 0 : last_edges[index] + 1;
+      while (value >= 0x80) {
+        output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+      }
+      output.push_back(static_cast<char>(value));
+    }
+  }
+
+  template <typename Weight>
+  void DiskRouter<Weight>::Build(const Graph& graph, const std::string& path, uint64_t seed, const VertexRanks& ranks) {
+    // Written next to the target and renamed over it, so a mapping of the old file stays valid
+    const std::string partial_path = path + ".partial";
+    std::ofstream output(partial_path, std::ios::binary | std::ios::trunc);
+    auto write_value = [&output](uint64_t value) {
+      output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    const size_t vertex_count = graph.GetVertexCount();
+    write_value(MAGIC);
+    write_value(vertex_count);
+    write_value(graph.GetEdgeCount());
+    write_value(ComputeFingerprint(graph, seed));
+
+    // Row offsets follow the header; they are filled in once every row has been written
+    std::vector<uint64_t> row_offsets(vertex_count + 1);
+    const uint64_t rows_begin = HEADER_SIZE + row_offsets.size() * sizeof(uint64_t);
+    output.seekp(rows_begin);
+
+    // Rows are computed in parallel batches and written in order. A batch holds as many rows
+    // as fit into BUILD_BUFFER_BYTES at the worst-case row size, but at least one per worker.
+    size_t max_varint_bytes = 1;
+    for (uint64_t value = graph.GetEdgeCount(); value >= 0x80; value >>= 7) {
+      ++max_varint_bytes;
+    }
+    const size_t max_row_bytes = GetCheckpointCount(vertex_count) * sizeof(uint32_t) + vertex_count * max_varint_bytes;
+    const size_t worker_count = GetWorkerCount(vertex_count);
+    const size_t batch_rows = std::max(worker_count, BUILD_BUFFER_BYTES / std::max<size_t>(1, max_row_bytes));
+    uint64_t offset = rows_begin;
+    for (size_t batch_begin = 0; batch_begin < vertex_count; batch_begin += batch_rows) {
+      const size_t batch_end = std::min(vertex_count, batch_begin + batch_rows);
+      // Several chunks per worker balance uneven rows; each chunk reuses one pair of search buffers
+      const size_t chunk_count = std::min(batch_end - batch_begin, 4 * worker_count);
+      std::vector<std::string> chunks(chunk_count);
+      std::vector<std::vector<size_t>> row_sizes(chunk_count);
+      auto get_chunk_begin = [&](size_t index) {
+        return batch_begin + (batch_end - batch_begin) * index / chunk_count;
+      };
+      ParallelFor(chunk_count, [&](size_t index) {
+        std::vector<std::optional<Weight>> distances(vertex_count);
+        std::vector<EdgeId> last_edges(vertex_count);
+        for (VertexId source = get_chunk_begin(index); source < get_chunk_begin(index + 1); ++source) {
+          const size_t size_before = chunks[index].size();
+          ComputeShortestPathTree(graph, source, distances, last_edges, nullptr, ranks);
+          EncodeRow(last_edges, chunks[index]);
+          row_sizes[index].push_back(chunks[index].size() - size_before);
+        }
+      });
+      for (size_t index = 0; index < chunk_count; ++index) {
+        size_t row = get_chunk_begin(index);
+        for (const size_t row_size : row_sizes[index]) {
+          row_offsets[row++] = offset;
+          offset += row_size;
+        }
+        output.write(chunks[index].data(), chunks[index].size());
+      }
+    }
+    row_offsets[vertex_count] = offset;
+
+    output.seekp(HEADER_SIZE);
+    output.write(reinterpret_cast<const char*>(row_offsets.data()), row_offsets.size() * sizeof(uint64_t));
+    output.close();
+    if (!output || std::rename(partial_path.c_str(), path.c_str()) != 0) {
+      std::remove(partial_path.c_str());
+      throw std::runtime_error("disk router: cannot write " + path);
+    }
+  }
+
+  template <typename Weight>
+  DiskRouter<Weight>::DiskRouter(const Graph& graph, const std::string& path, uint64_t seed)
+      : graph_(graph)
+  {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("disk router: cannot open " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < HEADER_SIZE) {
+      close(fd);
+      throw std::runtime_error("disk router: unsupported file format");
+    }
+    file_size_ = file_stat.st_size;
+    void* mapping = mmap(nullptr, file_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("disk router: cannot map " + path);
+    }
+    data_ = static_cast<const unsigned char*>(mapping);
+    madvise(mapping, file_size_, MADV_RANDOM);
+
+    uint64_t header[4];
+    std::memcpy(header, data_, sizeof(header));
+    const size_t vertex_count = graph.GetVertexCount();
+    if (header[0] != MAGIC || file_size_ < HEADER_SIZE + (vertex_count + 1) * sizeof(uint64_t)) {
+      munmap(mapping, file_size_);
+      throw std::runtime_error("disk router: unsupported file format");
+    }
+    if (header[1] != vertex_count || header[2] != graph.GetEdgeCount()) {
+      munmap(mapping, file_size_);
+      throw std::runtime_error("disk router: file was built for a different graph");
+    }
+    if (header[3] != ComputeFingerprint(graph, seed)) {
+      munmap(mapping, file_size_);
+      throw std::runtime_error("disk router: file was built for different weights");
+    }
+    if (GetRowOffset(vertex_count) != file_size_) {
+      munmap(mapping, file_size_);
+      throw std::runtime_error("disk router: truncated file");
+    }
+  }
+
+  template <typename Weight>
+  DiskRouter<Weight>::~DiskRouter() {
+    munmap(const_cast<unsigned char*>(data_), file_size_);
+  }
+
+  template <typename Weight>
+  uint64_t DiskRouter<Weight>::GetRowOffset(VertexId vertex) const {
+    uint64_t offset;
+    std::memcpy(&offset, data_ + HEADER_SIZE + vertex * sizeof(uint64_t), sizeof(offset));
+    return offset;
+  }
+
+  template <typename Weight>
+  uint64_t DiskRouter<Weight>::GetEntry(VertexId from, VertexId to) const {
+    const unsigned char* row = data_ + GetRowOffset(from);
+    uint32_t checkpoint;
+    std::memcpy(&checkpoint, row + to / CHECKPOINT_STRIDE * sizeof(uint32_t), sizeof(checkpoint));
+    const unsigned char* position = row + checkpoint;
+    for (size_t skip = to % CHECKPOINT_STRIDE; skip > 0; --skip) {
+      while (*position++ & 0x80) {
+      }
+    }
+    uint64_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+      const unsigned char byte = *position++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+  }
+
+  template <typename Weight>
+  std::optional<typename DiskRouter<Weight>::RouteInfo> DiskRouter<Weight>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+    if (from == to) {
+      return RouteInfo{0, {}};
+    }
+    if (GetEntry(from, to) == 0) {
+      return std::nullopt;
+    }
+    RouteInfo route{0, {}};
+    for (VertexId vertex = to; vertex != from; ) {
+      const EdgeId edge_id = GetEntry(from, vertex) - 1;
+      route.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(route.edges.begin(), route.edges.end());
+    // Summed in path order, as Dijkstra did, so the weight matches the search bit for bit
+    for (const EdgeId edge_id : route.edges) {
+      route.weight += graph_.GetEdge(edge_id).weight;
+    }
+    if (stats) {
+      stats->relaxed_edges += route.edges.size();
+    }
+    return route;
+  }
+
+  template <typename Weight>
+  size_t DiskRouter<Weight>::GetFileBytes() const {
+    return file_size_;
+  }
+
+  template <typename Weight>
+  size_t DiskRouter<Weight>::GetMemoryBytes() const {
+    // Only the page cache holds the table
+    return 0;
+  }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
 #include <deque>
 #include <string>
@@ -24,6 +25,22 @@ namespace Graph {
   using VertexId = size_t;
   using EdgeId = size_t;
 
+  // Work done by one route query: settled vertices and relaxed edges for searches,
+  // scanned label entries for label-based engines.
+  struct SearchStats {
+    size_t settled_vertices = 0;
+    size_t relaxed_edges = 0;
+  };
+
+  // Position of every vertex in a reference numbering; empty means the vertex ids themselves.
+  // Searches take equal-weight vertices in this order, so renumbering the graph does not change
+  // which of several equally short routes is found.
+  using VertexRanks = std::vector<size_t>;
+
+  inline size_t GetVertexRank(const VertexRanks& ranks, VertexId vertex) {
+    return ranks.empty() ? vertex : ranks[vertex];
+  }
+
   template <typename Weight>
   struct Edge {
     VertexId from;
@@ -40,6 +57,7 @@ namespace Graph {
   public:
     DirectedWeightedGraph(size_t vertex_count);
     EdgeId AddEdge(const Edge<Weight>& edge);
+    void UpdateEdgeWeight(EdgeId edge_id, Weight weight);
 
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
@@ -52,6 +70,12 @@ namespace Graph {
   };
 
 
+  // FNV-1a hash of the vertex count and every edge (ends and weight bits), mixed with seed.
+  // Saved indices keep it to detect a graph that changed since they were built.
+  template <typename Weight>
+  uint64_t ComputeFingerprint(const DirectedWeightedGraph<Weight>& graph, uint64_t seed = 0);
+
+
   template <typename Weight>
   DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) : incidence_lists_(vertex_count) {}
 
@@ -63,6 +87,11 @@ namespace Graph {
     return id;
   }
 
+  template <typename Weight>
+  void DirectedWeightedGraph<Weight>::UpdateEdgeWeight(EdgeId edge_id, Weight weight) {
+    edges_[edge_id].weight = weight;
+  }
+
   template <typename Weight>
   size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
     return incidence_lists_.size();
@@ -84,4 +113,25 @@ namespace Graph {
     const auto& edges = incidence_lists_[vertex];
     return {std::begin(edges), std::end(edges)};
   }
+
+  template <typename Weight>
+  uint64_t ComputeFingerprint(const DirectedWeightedGraph<Weight>& graph, uint64_t seed) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+      const auto* bytes = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+      }
+    };
+    const uint64_t vertex_count = graph.GetVertexCount();
+    mix(&seed, sizeof(seed));
+    mix(&vertex_count, sizeof(vertex_count));
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+      const auto& edge = graph.GetEdge(edge_id);
+      const uint64_t ends[2] = {edge.from, edge.to};
+      mix(ends, sizeof(ends));
+      mix(&edge.weight, sizeof(edge.weight));
+    }
+    return hash;
+  }
 }
@@ -0,0 +1,354 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // Pruned landmark labeling: every vertex keeps a forward label (hubs it reaches)
+  // and a backward label (hubs reaching it), both sorted by hub rank.
+  template <typename Weight>
+  class HubLabels {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    // The saved index records ComputeFingerprint(graph, seed); seed stands for whatever else the
+    // weights were derived from. Loading throws when the file was saved for another fingerprint.
+    // Hubs of equal degree are ranked, and equal-weight vertices searched, in the order of ranks.
+    explicit HubLabels(const Graph& graph, uint64_t seed = 0, const VertexRanks& ranks = {});
+    HubLabels(const Graph& graph, std::istream& input, uint64_t seed = 0);
+
+    struct RouteInfo {
+      Weight weight;
+      std::vector<EdgeId> edges;
+    };
+
+    std::optional<Weight> GetDistance(VertexId from, VertexId to) const;
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    void Serialize(std::ostream& output) const;
+    size_t GetLabelEntryCount() const;
+    size_t GetMemoryBytes() const;
+
+  private:
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+    static constexpr uint64_t MAGIC = 0x324C4255485452ULL;
+
+    struct LabelEntry {
+      VertexId hub_rank;
+      Weight weight;
+      EdgeId via_edge;
+    };
+    using Labels = std::vector<std::vector<LabelEntry>>;
+
+    struct Label {
+      std::vector<size_t> offsets;
+      std::vector<LabelEntry> entries;
+    };
+
+    struct HubMatch {
+      Weight weight;
+      VertexId hub_rank;
+    };
+
+    const Graph& graph_;
+    uint64_t fingerprint_;
+    std::vector<VertexId> rank_to_vertex_;
+    Label forward_;
+    Label backward_;
+
+    static std::optional<HubMatch> MergeLabels(const std::vector<LabelEntry>& forward,
+                                               const std::vector<LabelEntry>& backward);
+    static std::optional<HubMatch> MergeLabels(const LabelEntry* forward_begin, const LabelEntry* forward_end,
+                                               const LabelEntry* backward_begin, const LabelEntry* backward_end);
+    static Label Flatten(Labels labels);
+    static const LabelEntry& FindEntry(const Label& label, VertexId vertex, VertexId hub_rank);
+
+    void BuildLabels(const VertexRanks& ranks);
+    void PrunedSearch(VertexId hub, VertexId hub_rank, bool forward, const VertexRanks& ranks,
+                      const std::vector<std::vector<EdgeId>>& reverse_incidence,
+                      Labels& forward_labels, Labels& backward_labels,
+                      std::vector<std::optional<Weight>>& distances,
+                      std::vector<EdgeId>& parent_edges);
+  };
+
+
+  template <typename Weight>
+  HubLabels<Weight>::HubLabels(const Graph& graph, uint64_t seed, const VertexRanks& ranks)
+      : graph_(graph), fingerprint_(ComputeFingerprint(graph, seed)) {
+    BuildLabels(ranks);
+  }
+
+  template <typename Weight>
+  HubLabels<Weight>::HubLabels(const Graph& graph, std::istream& input, uint64_t seed)
+      : graph_(graph), fingerprint_(ComputeFingerprint(graph, seed)) {
+    auto read_value = [&input](auto& value) {
+      input.read(reinterpret_cast<char*>(&value), sizeof(value));
+    };
+    auto read_vector = [&input, &read_value](auto& values) {
+      uint64_t size = 0;
+      read_value(size);
+      values.resize(size);
+      input.read(reinterpret_cast<char*>(values.data()), size * sizeof(values[0]));
+    };
+
+    uint64_t magic = 0, weight_size = 0, vertex_count = 0, edge_count = 0, fingerprint = 0;
+    read_value(magic);
+    read_value(weight_size);
+    read_value(vertex_count);
+    read_value(edge_count);
+    read_value(fingerprint);
+    if (!input || magic != MAGIC || weight_size != sizeof(Weight)) {
+      throw std::runtime_error("hub labels: unsupported file format");
+    }
+    if (vertex_count != graph.GetVertexCount() || edge_count != graph.GetEdgeCount() || fingerprint != fingerprint_) {
+      throw std::runtime_error("hub labels: file was built for a different graph");
+    }
+    read_vector(rank_to_vertex_);
+    read_vector(forward_.offsets);
+    read_vector(forward_.entries);
+    read_vector(backward_.offsets);
+    read_vector(backward_.entries);
+    if (!input) {
+      throw std::runtime_error("hub labels: truncated file");
+    }
+  }
+
+  template <typename Weight>
+  void HubLabels<Weight>::Serialize(std::ostream& output) const {
+    auto write_value = [&output](const auto& value) {
+      output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto write_vector = [&output, &write_value](const auto& values) {
+      write_value(static_cast<uint64_t>(values.size()));
+      output.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(values[0]));
+    };
+
+    write_value(MAGIC);
+    write_value(static_cast<uint64_t>(sizeof(Weight)));
+    write_value(static_cast<uint64_t>(graph_.GetVertexCount()));
+    write_value(static_cast<uint64_t>(graph_.GetEdgeCount()));
+    write_value(fingerprint_);
+    write_vector(rank_to_vertex_);
+    write_vector(forward_.offsets);
+    write_vector(forward_.entries);
+    write_vector(backward_.offsets);
+    write_vector(backward_.entries);
+  }
+
+  template <typename Weight>
+  size_t HubLabels<Weight>::GetLabelEntryCount() const {
+    return forward_.entries.size() + backward_.entries.size();
+  }
+
+  template <typename Weight>
+  size_t HubLabels<Weight>::GetMemoryBytes() const {
+    return rank_to_vertex_.size() * sizeof(VertexId)
+        + (forward_.offsets.size() + backward_.offsets.size()) * sizeof(size_t)
+        + GetLabelEntryCount() * sizeof(LabelEntry);
+  }
+
+  template <typename Weight>
+  void HubLabels<Weight>::BuildLabels(const VertexRanks& ranks) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<std::vector<EdgeId>> reverse_incidence(vertex_count);
+    std::vector<size_t> degree(vertex_count, 0);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      reverse_incidence[edge.to].push_back(edge_id);
+      ++degree[edge.from];
+      ++degree[edge.to];
+    }
+
+    rank_to_vertex_.resize(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      rank_to_vertex_[GetVertexRank(ranks, vertex)] = vertex;
+    }
+    std::stable_sort(rank_to_vertex_.begin(), rank_to_vertex_.end(),
+                     [&degree](VertexId lhs, VertexId rhs) { return degree[lhs] > degree[rhs]; });
+
+    Labels forward_labels(vertex_count);
+    Labels backward_labels(vertex_count);
+    std::vector<std::optional<Weight>> distances(vertex_count);
+    std::vector<EdgeId> parent_edges(vertex_count, NO_EDGE);
+    for (VertexId hub_rank = 0; hub_rank < vertex_count; ++hub_rank) {
+      const VertexId hub = rank_to_vertex_[hub_rank];
+      PrunedSearch(hub, hub_rank, true, ranks, reverse_incidence, forward_labels, backward_labels, distances, parent_edges);
+      PrunedSearch(hub, hub_rank, false, ranks, reverse_incidence, forward_labels, backward_labels, distances, parent_edges);
+    }
+
+    forward_ = Flatten(std::move(forward_labels));
+    backward_ = Flatten(std::move(backward_labels));
+  }
+
+  // forward == true walks out-edges from the hub and fills backward labels (hub -> v),
+  // forward == false walks in-edges and fills forward labels (v -> hub).
+  template <typename Weight>
+  void HubLabels<Weight>::PrunedSearch(VertexId hub, VertexId hub_rank, bool forward, const VertexRanks& ranks,
+                                       const std::vector<std::vector<EdgeId>>& reverse_incidence,
+                                       Labels& forward_labels, Labels& backward_labels,
+                                       std::vector<std::optional<Weight>>& distances,
+                                       std::vector<EdgeId>& parent_edges) {
+    using QueueItem = std::tuple<Weight, size_t, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    std::vector<VertexId> touched;
+
+    distances[hub] = 0;
+    touched.push_back(hub);
+    queue.push({0, GetVertexRank(ranks, hub), hub});
+    auto& labels_to_fill = forward ? backward_labels : forward_labels;
+
+    while (!queue.empty()) {
+      const Weight weight = std::get<0>(queue.top());
+      const VertexId vertex = std::get<2>(queue.top());
+      queue.pop();
+      if (weight > *distances[vertex]) {
+        continue;
+      }
+      if (vertex != hub) {
+        const auto covered = forward
+            ? MergeLabels(forward_labels[hub], backward_labels[vertex])
+            : MergeLabels(forward_labels[vertex], backward_labels[hub]);
+        if (covered && covered->weight <= weight) {
+          continue;
+        }
+      }
+      labels_to_fill[vertex].push_back({hub_rank, weight, parent_edges[vertex]});
+
+      auto relax = [&](EdgeId edge_id, VertexId next) {
+        const Weight candidate = weight + graph_.GetEdge(edge_id).weight;
+        if (!distances[next] || candidate < *distances[next]) {
+          if (!distances[next]) {
+            touched.push_back(next);
+          }
+          distances[next] = candidate;
+          parent_edges[next] = edge_id;
+          queue.push({candidate, GetVertexRank(ranks, next), next});
+        }
+      };
+      if (forward) {
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+          relax(edge_id, graph_.GetEdge(edge_id).to);
+        }
+      } else {
+        for (const EdgeId edge_id : reverse_incidence[vertex]) {
+          relax(edge_id, graph_.GetEdge(edge_id).from);
+        }
+      }
+    }
+
+    for (const VertexId vertex : touched) {
+      distances[vertex] = std::nullopt;
+      parent_edges[vertex] = NO_EDGE;
+    }
+  }
+
+  template <typename Weight>
+  typename HubLabels<Weight>::Label HubLabels<Weight>::Flatten(Labels labels) {
+    Label result;
+    result.offsets.reserve(labels.size() + 1);
+    result.offsets.push_back(0);
+    for (const auto& label : labels) {
+      result.offsets.push_back(result.offsets.back() + label.size());
+    }
+    result.entries.reserve(result.offsets.back());
+    for (auto& label : labels) {
+      result.entries.insert(result.entries.end(), label.begin(), label.end());
+      std::vector<LabelEntry>().swap(label);
+    }
+    return result;
+  }
+
+  template <typename Weight>
+  std::optional<typename HubLabels<Weight>::HubMatch>
+  HubLabels<Weight>::MergeLabels(const std::vector<LabelEntry>& forward, const std::vector<LabelEntry>& backward) {
+    return MergeLabels(forward.data(), forward.data() + forward.size(),
+                       backward.data(), backward.data() + backward.size());
+  }
+
+  template <typename Weight>
+  std::optional<typename HubLabels<Weight>::HubMatch>
+  HubLabels<Weight>::MergeLabels(const LabelEntry* forward_begin, const LabelEntry* forward_end,
+                                 const LabelEntry* backward_begin, const LabelEntry* backward_end) {
+    std::optional<HubMatch> best;
+    while (forward_begin != forward_end && backward_begin != backward_end) {
+      if (forward_begin->hub_rank < backward_begin->hub_rank) {
+        ++forward_begin;
+      } else if (backward_begin->hub_rank < forward_begin->hub_rank) {
+        ++backward_begin;
+      } else {
+        const Weight candidate = forward_begin->weight + backward_begin->weight;
+        if (!best || candidate < best->weight) {
+          best = HubMatch{candidate, forward_begin->hub_rank};
+        }
+        ++forward_begin;
+        ++backward_begin;
+      }
+    }
+    return best;
+  }
+
+  template <typename Weight>
+  const typename HubLabels<Weight>::LabelEntry&
+  HubLabels<Weight>::FindEntry(const Label& label, VertexId vertex, VertexId hub_rank) {
+    const auto begin = label.entries.begin() + label.offsets[vertex];
+    const auto end = label.entries.begin() + label.offsets[vertex + 1];
+    return *std::lower_bound(begin, end, hub_rank,
+                             [](const LabelEntry& entry, VertexId rank) { return entry.hub_rank < rank; });
+  }
+
+  template <typename Weight>
+  std::optional<Weight> HubLabels<Weight>::GetDistance(VertexId from, VertexId to) const {
+    const auto match = MergeLabels(forward_.entries.data() + forward_.offsets[from],
+                                   forward_.entries.data() + forward_.offsets[from + 1],
+                                   backward_.entries.data() + backward_.offsets[to],
+                                   backward_.entries.data() + backward_.offsets[to + 1]);
+    if (!match) {
+      return std::nullopt;
+    }
+    return match->weight;
+  }
+
+  template <typename Weight>
+  std::optional<typename HubLabels<Weight>::RouteInfo> HubLabels<Weight>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+    const auto match = MergeLabels(forward_.entries.data() + forward_.offsets[from],
+                                   forward_.entries.data() + forward_.offsets[from + 1],
+                                   backward_.entries.data() + backward_.offsets[to],
+                                   backward_.entries.data() + backward_.offsets[to + 1]);
+    if (stats) {
+      stats->relaxed_edges += forward_.offsets[from + 1] - forward_.offsets[from]
+                            + backward_.offsets[to + 1] - backward_.offsets[to];
+    }
+    if (!match) {
+      return std::nullopt;
+    }
+    const VertexId hub = rank_to_vertex_[match->hub_rank];
+
+    RouteInfo route{match->weight, {}};
+    for (VertexId vertex = from; vertex != hub; ) {
+      const EdgeId edge_id = FindEntry(forward_, vertex, match->hub_rank).via_edge;
+      route.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).to;
+    }
+    const size_t hub_position = route.edges.size();
+    for (VertexId vertex = to; vertex != hub; ) {
+      const EdgeId edge_id = FindEntry(backward_, vertex, match->hub_rank).via_edge;
+      route.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(route.edges.begin() + hub_position, route.edges.end());
+    return route;
+  }
+}
@@ -4,6 +4,8 @@
 #include <istream>
 #include <map>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -45,5 +47,14 @@ namespace Json {
   };
 
   Document Load(std::istream& input);
+  Node LoadNode(std::string_view text);
+
+  // Writes text as a quoted JSON string, escaping quotes, backslashes and control characters.
+  void PrintString(std::ostream& output, std::string_view text);
+
+  // Structural pre-scan without building nodes: raw text of each top-level
+  // member of an object / element of an array.
+  std::vector<std::pair<std::string, std::string_view>> ScanObjectMembers(std::string_view text);
+  std::vector<std::string_view> ScanArrayElements(std::string_view text);
 
 }
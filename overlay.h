@@ -0,0 +1,363 @@
+#pragma once
+
+#include "graph.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // Partition-based router (Customizable Route Planning with one overlay level).
+  // Vertices are split into cells; every cell keeps a clique of shortest paths
+  // between its boundary vertices. A query runs Dijkstra over the source and
+  // target cells plus the overlay of all other cells.
+  template <typename Weight>
+  class OverlayRouter {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    // Cells are grown from seeds, and equal-weight vertices searched, in the order of ranks.
+    OverlayRouter(const Graph& graph, size_t max_cell_size = 0, VertexRanks ranks = {});
+
+    struct RouteInfo {
+      Weight weight;
+      std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    // Recomputes cliques of cells touched by changed edges; call after the graph weights change.
+    void Customize(const std::vector<EdgeId>& changed_edges);
+    void CustomizeAll();
+
+    size_t GetCellCount() const;
+    size_t GetBoundaryVertexCount() const;
+    size_t GetMemoryBytes() const;
+
+  private:
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+    struct Cell {
+      std::vector<VertexId> vertices;
+      std::vector<VertexId> boundary;
+      // clique[i * boundary.size() + j] is the distance from boundary[i] to boundary[j] inside the cell
+      std::vector<std::optional<Weight>> clique;
+      // parent_edges[i][local] is the last edge on the in-cell path from boundary[i] to vertices[local]
+      std::vector<std::vector<EdgeId>> parent_edges;
+    };
+
+    // Query buffers of the calling thread, shared by all routers of this weight type. Only touched
+    // entries are reset after a query, so a query costs O(searched part) instead of O(V).
+    struct SearchScratch {
+      std::vector<std::optional<Weight>> distances;
+      std::vector<EdgeId> parent_edges;
+      std::vector<VertexId> parent_vertices;
+      std::vector<VertexId> touched;
+    };
+
+    const Graph& graph_;
+    VertexRanks ranks_;
+    std::vector<size_t> cell_of_;
+    std::vector<size_t> local_index_;
+    std::vector<size_t> boundary_index_;
+    std::vector<Cell> cells_;
+
+    void Partition(size_t max_cell_size);
+    void FindBoundaries();
+    void CustomizeCell(size_t cell_id);
+    void UnpackShortcut(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
+    static SearchScratch& GetScratch(size_t vertex_count);
+  };
+
+
+  template <typename Weight>
+  OverlayRouter<Weight>::OverlayRouter(const Graph& graph, size_t max_cell_size, VertexRanks ranks)
+      : graph_(graph),
+        ranks_(std::move(ranks)),
+        cell_of_(graph.GetVertexCount(), NONE),
+        local_index_(graph.GetVertexCount(), NONE),
+        boundary_index_(graph.GetVertexCount(), NONE)
+  {
+    if (max_cell_size == 0) {
+      max_cell_size = std::max<size_t>(16, static_cast<size_t>(std::sqrt(graph.GetVertexCount())));
+    }
+    Partition(max_cell_size);
+    FindBoundaries();
+    CustomizeAll();
+  }
+
+  template <typename Weight>
+  size_t OverlayRouter<Weight>::GetCellCount() const {
+    return cells_.size();
+  }
+
+  template <typename Weight>
+  size_t OverlayRouter<Weight>::GetBoundaryVertexCount() const {
+    size_t result = 0;
+    for (const auto& cell : cells_) {
+      result += cell.boundary.size();
+    }
+    return result;
+  }
+
+  template <typename Weight>
+  size_t OverlayRouter<Weight>::GetMemoryBytes() const {
+    size_t result = 3 * cell_of_.size() * sizeof(size_t);
+    for (const auto& cell : cells_) {
+      result += (cell.vertices.size() + cell.boundary.size()) * sizeof(VertexId);
+      result += cell.clique.size() * sizeof(std::optional<Weight>);
+      result += cell.boundary.size() * cell.vertices.size() * sizeof(EdgeId);
+    }
+    return result;
+  }
+
+  // Grows cells by BFS over the undirected view of the graph, so that every cell is connected
+  // whenever its part of the graph is.
+  template <typename Weight>
+  void OverlayRouter<Weight>::Partition(size_t max_cell_size) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<std::vector<VertexId>> neighbours(vertex_count);
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      if (edge.from != edge.to) {
+        neighbours[edge.from].push_back(edge.to);
+        neighbours[edge.to].push_back(edge.from);
+      }
+    }
+
+    std::vector<VertexId> seeds(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      seeds[GetVertexRank(ranks_, vertex)] = vertex;
+    }
+    for (const VertexId seed : seeds) {
+      if (cell_of_[seed] != NONE) {
+        continue;
+      }
+      const size_t cell_id = cells_.size();
+      Cell& cell = cells_.emplace_back();
+      std::deque<VertexId> queue{seed};
+      cell_of_[seed] = cell_id;
+      while (!queue.empty() && cell.vertices.size() < max_cell_size) {
+        const VertexId vertex = queue.front();
+        queue.pop_front();
+        local_index_[vertex] = cell.vertices.size();
+        cell.vertices.push_back(vertex);
+        for (const VertexId next : neighbours[vertex]) {
+          if (cell_of_[next] == NONE) {
+            cell_of_[next] = cell_id;
+            queue.push_back(next);
+          }
+        }
+      }
+      for (const VertexId vertex : queue) {
+        cell_of_[vertex] = NONE;
+      }
+    }
+  }
+
+  template <typename Weight>
+  void OverlayRouter<Weight>::FindBoundaries() {
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      if (cell_of_[edge.from] == cell_of_[edge.to]) {
+        continue;
+      }
+      for (const VertexId vertex : {edge.from, edge.to}) {
+        if (boundary_index_[vertex] == NONE) {
+          auto& boundary = cells_[cell_of_[vertex]].boundary;
+          boundary_index_[vertex] = boundary.size();
+          boundary.push_back(vertex);
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  void OverlayRouter<Weight>::CustomizeAll() {
+    ParallelFor(cells_.size(), [this](size_t cell_id) { CustomizeCell(cell_id); });
+  }
+
+  template <typename Weight>
+  void OverlayRouter<Weight>::Customize(const std::vector<EdgeId>& changed_edges) {
+    std::set<size_t> dirty_cells;
+    for (const EdgeId edge_id : changed_edges) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      if (cell_of_[edge.from] == cell_of_[edge.to]) {
+        dirty_cells.insert(cell_of_[edge.from]);
+      }
+    }
+    const std::vector<size_t> cells(dirty_cells.begin(), dirty_cells.end());
+    ParallelFor(cells.size(), [this, &cells](size_t index) { CustomizeCell(cells[index]); });
+  }
+
+  template <typename Weight>
+  void OverlayRouter<Weight>::CustomizeCell(size_t cell_id) {
+    Cell& cell = cells_[cell_id];
+    const size_t boundary_size = cell.boundary.size();
+    cell.clique.assign(boundary_size * boundary_size, std::nullopt);
+    cell.parent_edges.assign(boundary_size, std::vector<EdgeId>(cell.vertices.size(), NONE));
+
+    using QueueItem = std::pair<Weight, size_t>;
+    std::vector<std::optional<Weight>> distances(cell.vertices.size());
+    for (size_t source = 0; source < boundary_size; ++source) {
+      std::fill(distances.begin(), distances.end(), std::nullopt);
+      auto& parent_edges = cell.parent_edges[source];
+      std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+      const size_t source_local = local_index_[cell.boundary[source]];
+      distances[source_local] = 0;
+      queue.push({0, source_local});
+      while (!queue.empty()) {
+        const Weight weight = queue.top().first;
+        const size_t local = queue.top().second;
+        queue.pop();
+        if (weight > *distances[local]) {
+          continue;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(cell.vertices[local])) {
+          const auto& edge = graph_.GetEdge(edge_id);
+          if (cell_of_[edge.to] != cell_id) {
+            continue;
+          }
+          const size_t next = local_index_[edge.to];
+          const Weight candidate = weight + edge.weight;
+          if (!distances[next] || candidate < *distances[next]) {
+            distances[next] = candidate;
+            parent_edges[next] = edge_id;
+            queue.push({candidate, next});
+          }
+        }
+      }
+      for (size_t target = 0; target < boundary_size; ++target) {
+        cell.clique[source * boundary_size + target] = distances[local_index_[cell.boundary[target]]];
+      }
+    }
+  }
+
+  template <typename Weight>
+  void OverlayRouter<Weight>::UnpackShortcut(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
+    const Cell& cell = cells_[cell_of_[from]];
+    const auto& parent_edges = cell.parent_edges[boundary_index_[from]];
+    const size_t first = edges.size();
+    for (VertexId vertex = to; vertex != from; ) {
+      const EdgeId edge_id = parent_edges[local_index_[vertex]];
+      edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin() + first, edges.end());
+  }
+
+  template <typename Weight>
+  typename OverlayRouter<Weight>::SearchScratch& OverlayRouter<Weight>::GetScratch(size_t vertex_count) {
+    thread_local SearchScratch scratch;
+    if (scratch.distances.size() < vertex_count) {
+      scratch.distances.resize(vertex_count);
+      scratch.parent_edges.resize(vertex_count, NONE);
+      scratch.parent_vertices.resize(vertex_count, NONE);
+    }
+    return scratch;
+  }
+
+  template <typename Weight>
+  std::optional<typename OverlayRouter<Weight>::RouteInfo> OverlayRouter<Weight>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+    const size_t from_cell = cell_of_[from];
+    const size_t to_cell = cell_of_[to];
+
+    // parent_edge == NONE with parent_vertex set marks a clique shortcut
+    SearchScratch& scratch = GetScratch(graph_.GetVertexCount());
+    auto& distances = scratch.distances;
+    auto& parent_edges = scratch.parent_edges;
+    auto& parent_vertices = scratch.parent_vertices;
+    auto& touched = scratch.touched;
+
+    using QueueItem = std::tuple<Weight, size_t, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    distances[from] = 0;
+    touched.push_back(from);
+    queue.push({0, GetVertexRank(ranks_, from), from});
+
+    SearchStats local_stats;
+    auto relax = [&](VertexId vertex, VertexId next, Weight candidate, EdgeId edge_id) {
+      ++local_stats.relaxed_edges;
+      if (!distances[next] || candidate < *distances[next]) {
+        if (!distances[next]) {
+          touched.push_back(next);
+        }
+        distances[next] = candidate;
+        parent_edges[next] = edge_id;
+        parent_vertices[next] = vertex;
+        queue.push({candidate, GetVertexRank(ranks_, next), next});
+      }
+    };
+
+    while (!queue.empty()) {
+      const Weight weight = std::get<0>(queue.top());
+      const VertexId vertex = std::get<2>(queue.top());
+      queue.pop();
+      if (weight > *distances[vertex]) {
+        continue;
+      }
+      ++local_stats.settled_vertices;
+      if (vertex == to) {
+        break;
+      }
+      const size_t cell_id = cell_of_[vertex];
+      const bool is_open_cell = cell_id == from_cell || cell_id == to_cell;
+      for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (is_open_cell || cell_of_[edge.to] != cell_id) {
+          relax(vertex, edge.to, weight + edge.weight, edge_id);
+        }
+      }
+      if (!is_open_cell) {
+        const Cell& cell = cells_[cell_id];
+        const size_t boundary_size = cell.boundary.size();
+        const size_t source = boundary_index_[vertex];
+        for (size_t target = 0; target < boundary_size; ++target) {
+          if (const auto& shortcut = cell.clique[source * boundary_size + target]; shortcut && target != source) {
+            relax(vertex, cell.boundary[target], weight + *shortcut, NONE);
+          }
+        }
+      }
+    }
+
+    if (stats) {
+      stats->settled_vertices += local_stats.settled_vertices;
+      stats->relaxed_edges += local_stats.relaxed_edges;
+    }
+
+    std::optional<RouteInfo> route;
+    if (distances[to]) {
+      std::vector<std::pair<VertexId, VertexId>> steps;
+      for (VertexId vertex = to; vertex != from; vertex = parent_vertices[vertex]) {
+        steps.push_back({parent_vertices[vertex], vertex});
+      }
+      route.emplace(RouteInfo{*distances[to], {}});
+      for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+        const auto [step_from, step_to] = *it;
+        if (const EdgeId edge_id = parent_edges[step_to]; edge_id != NONE) {
+          route->edges.push_back(edge_id);
+        } else {
+          UnpackShortcut(step_from, step_to, route->edges);
+        }
+      }
+    }
+
+    for (const VertexId vertex : touched) {
+      distances[vertex] = std::nullopt;
+      parent_edges[vertex] = NONE;
+      parent_vertices[vertex] = NONE;
+    }
+    touched.clear();
+    return route;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline size_t GetWorkerCount(size_t task_count) {
+  const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(hardware, task_count));
+}
+
+// Calls func(index) for every index in [0, count) on a pool of worker threads.
+// Indices are handed out dynamically, so uneven tasks balance themselves.
+template <typename Func>
+void ParallelFor(size_t count, Func func) {
+  const size_t worker_count = GetWorkerCount(count);
+  if (worker_count <= 1) {
+    for (size_t index = 0; index < count; ++index) {
+      func(index);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_index{0};
+  auto worker = [&]() {
+    for (size_t index = next_index++; index < count; index = next_index++) {
+      func(index);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(worker_count - 1);
+  for (size_t i = 1; i < worker_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // Strongly connected components plus reachability between them. Components are
+  // numbered by Tarjan's algorithm, so every component reachable from c has an id <= c;
+  // this alone rejects half of the unreachable pairs. When the condensed DAG is small
+  // enough, every component also keeps a bitset of the components it reaches.
+  template <typename Weight>
+  class ReachabilityIndex {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    static constexpr size_t DEFAULT_MAX_BITSET_BYTES = 64 << 20;
+
+    explicit ReachabilityIndex(const Graph& graph, size_t max_bitset_bytes = DEFAULT_MAX_BITSET_BYTES);
+
+    // false means that there is certainly no path; true may be a false positive
+    // only when the bitsets were over the size limit.
+    bool CanReach(VertexId from, VertexId to) const;
+
+    size_t GetComponent(VertexId vertex) const;
+    size_t GetComponentCount() const;
+    bool HasBitsets() const;
+    size_t GetMemoryBytes() const;
+
+  private:
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+    std::vector<size_t> component_of_;
+    size_t component_count_ = 0;
+    size_t words_per_row_ = 0;
+    std::vector<uint64_t> reach_bits_;
+
+    void FindComponents(const Graph& graph);
+    void BuildBitsets(const Graph& graph);
+  };
+
+
+  template <typename Weight>
+  ReachabilityIndex<Weight>::ReachabilityIndex(const Graph& graph, size_t max_bitset_bytes)
+      : component_of_(graph.GetVertexCount(), NONE)
+  {
+    FindComponents(graph);
+    const size_t words_per_row = (component_count_ + 63) / 64;
+    if (words_per_row * component_count_ * sizeof(uint64_t) <= max_bitset_bytes) {
+      words_per_row_ = words_per_row;
+      BuildBitsets(graph);
+    }
+  }
+
+  // Iterative Tarjan, so that long chains of stops do not overflow the call stack.
+  template <typename Weight>
+  void ReachabilityIndex<Weight>::FindComponents(const Graph& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    std::vector<size_t> index(vertex_count, NONE);
+    std::vector<size_t> lowlink(vertex_count);
+    std::vector<bool> on_stack(vertex_count, false);
+    std::vector<VertexId> stack;
+    std::vector<std::pair<VertexId, size_t>> frames;
+    size_t next_index = 0;
+
+    for (VertexId root = 0; root < vertex_count; ++root) {
+      if (index[root] != NONE) {
+        continue;
+      }
+      index[root] = lowlink[root] = next_index++;
+      stack.push_back(root);
+      on_stack[root] = true;
+      frames.push_back({root, 0});
+      while (!frames.empty()) {
+        const VertexId vertex = frames.back().first;
+        const auto edges = graph.GetIncidentEdges(vertex);
+        const size_t position = frames.back().second;
+        if (edges.begin() + position != edges.end()) {
+          ++frames.back().second;
+          const VertexId next = graph.GetEdge(*(edges.begin() + position)).to;
+          if (index[next] == NONE) {
+            index[next] = lowlink[next] = next_index++;
+            stack.push_back(next);
+            on_stack[next] = true;
+            frames.push_back({next, 0});
+          } else if (on_stack[next]) {
+            lowlink[vertex] = std::min(lowlink[vertex], index[next]);
+          }
+          continue;
+        }
+        if (lowlink[vertex] == index[vertex]) {
+          VertexId member;
+          do {
+            member = stack.back();
+            stack.pop_back();
+            on_stack[member] = false;
+            component_of_[member] = component_count_;
+          } while (member != vertex);
+          ++component_count_;
+        }
+        frames.pop_back();
+        if (!frames.empty()) {
+          const VertexId parent = frames.back().first;
+          lowlink[parent] = std::min(lowlink[parent], lowlink[vertex]);
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  void ReachabilityIndex<Weight>::BuildBitsets(const Graph& graph) {
+    std::vector<std::vector<size_t>> successors(component_count_);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+      const auto& edge = graph.GetEdge(edge_id);
+      const size_t from = component_of_[edge.from];
+      const size_t to = component_of_[edge.to];
+      if (from != to) {
+        successors[from].push_back(to);
+      }
+    }
+
+    // Successors always have smaller ids, so their rows are complete when they are merged
+    reach_bits_.assign(component_count_ * words_per_row_, 0);
+    std::vector<size_t> merged_into(component_count_, NONE);
+    for (size_t component = 0; component < component_count_; ++component) {
+      uint64_t* row = reach_bits_.data() + component * words_per_row_;
+      row[component / 64] |= uint64_t{1} << (component % 64);
+      for (const size_t next : successors[component]) {
+        if (merged_into[next] == component) {
+          continue;
+        }
+        merged_into[next] = component;
+        const uint64_t* next_row = reach_bits_.data() + next * words_per_row_;
+        for (size_t word = 0; word <= next / 64; ++word) {
+          row[word] |= next_row[word];
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  bool ReachabilityIndex<Weight>::CanReach(VertexId from, VertexId to) const {
+    const size_t from_component = component_of_[from];
+    const size_t to_component = component_of_[to];
+    if (from_component == to_component) {
+      return true;
+    }
+    if (from_component < to_component) {
+      return false;
+    }
+    if (words_per_row_ == 0) {
+      return true;
+    }
+    const uint64_t word = reach_bits_[from_component * words_per_row_ + to_component / 64];
+    return (word >> (to_component % 64)) & 1;
+  }
+
+  template <typename Weight>
+  size_t ReachabilityIndex<Weight>::GetComponent(VertexId vertex) const {
+    return component_of_[vertex];
+  }
+
+  template <typename Weight>
+  size_t ReachabilityIndex<Weight>::GetComponentCount() const {
+    return component_count_;
+  }
+
+  template <typename Weight>
+  bool ReachabilityIndex<Weight>::HasBitsets() const {
+    return words_per_row_ != 0;
+  }
+
+  template <typename Weight>
+  size_t ReachabilityIndex<Weight>::GetMemoryBytes() const {
+    return component_of_.size() * sizeof(size_t) + reach_bits_.size() * sizeof(uint64_t);
+  }
+}
@@ -0,0 +1,236 @@
+#include "Requests.h"
+#include "Transport.h"
+#include "Profile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <sys/resource.h>
+
+using namespace std;
+
+// Replays a stream of stat requests (one JSON object per line) against a base
+// loaded in-process and reports throughput, latency percentiles and peak RSS.
+
+struct ReplayOptions{
+    string base_path;
+    string requests_path;
+    size_t concurrency = 1;
+    double rate = 0.0;
+    size_t repeat = 1;
+    // Routing settings JSON to switch to after the replay; empty keeps the base settings
+    string switch_settings;
+};
+
+struct LatencySample{
+    size_t type;
+    double latency_us;
+};
+
+const char* const Request_Types[] = {"Stop","Bus","Route"};
+
+ReplayOptions ReadReplayOptions(int argc, char* argv[]){
+    ReplayOptions options;
+    for(int i = 1; i < argc; i++){
+        const string_view arg = argv[i];
+        if(arg.substr(0,7) == "--base="){
+            options.base_path = string(arg.substr(7));
+        }
+        else if(arg.substr(0,11) == "--requests="){
+            options.requests_path = string(arg.substr(11));
+        }
+        else if(arg.substr(0,14) == "--concurrency="){
+            options.concurrency = max<size_t>(1,stoul(string(arg.substr(14))));
+        }
+        else if(arg.substr(0,7) == "--rate="){
+            options.rate = stod(string(arg.substr(7)));
+        }
+        else if(arg.substr(0,9) == "--repeat="){
+            options.repeat = max<size_t>(1,stoul(string(arg.substr(9))));
+        }
+        else if(arg.substr(0,18) == "--switch-settings="){
+            options.switch_settings = string(arg.substr(18));
+        }
+    }
+    return options;
+}
+
+vector<StatsRequest> ReadRequestStream(istream& input){
+    vector<Json::Node> nodes;
+    for(string line; getline(input,line); ){
+        if(line.find_first_not_of(" \t\r") == string::npos){
+            continue;
+        }
+        istringstream line_input(line);
+        nodes.push_back(Json::Load(line_input).GetRoot());
+    }
+    return ReadStatsRequests(nodes);
+}
+
+size_t GetRequestType(const StatsRequest& request){
+    if(request.type == "Stop"){
+        return 0;
+    }
+    if(request.type == "Bus"){
+        return 1;
+    }
+    return 2;
+}
+
+double Percentile(const vector<double>& sorted,double quantile){
+    if(sorted.empty()){
+        return 0.0;
+    }
+    const size_t idx = min(sorted.size() - 1,static_cast<size_t>(quantile * sorted.size()));
+    return sorted[idx];
+}
+
+// Switches the built system to other routing settings and counts the Route answers that differ
+// from a system built from scratch for them. Called once every replay thread has been joined.
+size_t CountSwitchMismatches(const vector<StatsRequest>& stats_request,TransportSystem& transport_system,
+    shared_ptr<StopManager> stops_base,shared_ptr<BusManager> bus_base,const RoutingOptions& routing_options,
+    const string& settings_text){
+    const auto settings_node = Json::LoadNode(settings_text);
+    transport_system.SetRoutingSettings(BusManager::ReadRouteSettings(settings_node));
+    bus_base->AddBusRoutingSettings(settings_node);
+    const TransportSystem fresh_system(bus_base,stops_base,routing_options);
+    size_t mismatches = 0;
+    ostringstream switched, fresh;
+    for(const auto& request : stats_request){
+        if(request.type != "Route"){
+            continue;
+        }
+        switched.str({});
+        fresh.str({});
+        PrintRouteResult(request,transport_system,switched);
+        PrintRouteResult(request,fresh_system,fresh);
+        mismatches += switched.str() != fresh.str();
+    }
+    return mismatches;
+}
+
+long GetPeakRssKb(){
+    rusage usage{};
+    getrusage(RUSAGE_SELF,&usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char* argv[]){
+    const auto options = ReadReplayOptions(argc,argv);
+    ApplyProfileOptions(argc,argv);
+    RoutingOptions routing_options;
+    try{
+        routing_options = ReadRoutingOptions(argc,argv);
+    }
+    catch(const invalid_argument& error){
+        cerr << error.what() << endl;
+        return 1;
+    }
+    if(options.base_path.empty()){
+        cerr << "usage: transport_replay --base=<input.json> [--requests=<requests.jsonl>] "
+                "[--concurrency=N] [--rate=<requests per second>] [--repeat=N] "
+                "[--switch-settings=<routing settings JSON>] [router options]" << endl;
+        return 1;
+    }
+
+    ifstream base_input(options.base_path);
+    auto document = ParceInput(base_input);
+    auto [stats_request,stops_base,bus_base] = ProcessInput(document);
+    bus_base->CalculateAndSetAllBusParams();
+    const ResponseCache response_cache(stops_base,bus_base);
+    if(!options.requests_path.empty()){
+        ifstream requests_input(options.requests_path);
+        stats_request = ReadRequestStream(requests_input);
+    }
+    routing_options.expected_route_queries = options.repeat * count_if(stats_request.begin(),stats_request.end(),
+        [](const StatsRequest& request){ return request.type == "Route"; });
+    TransportSystem transport_system(bus_base,stops_base,routing_options);
+
+    const size_t total = stats_request.size() * options.repeat;
+    vector<vector<LatencySample>> samples(options.concurrency);
+    atomic<size_t> next_request{0};
+    const auto start = chrono::steady_clock::now();
+    auto worker = [&](size_t worker_idx){
+        auto& worker_samples = samples[worker_idx];
+        ostringstream output;
+        for(size_t idx = next_request++; idx < total; idx = next_request++){
+            const auto& request = stats_request[idx % stats_request.size()];
+            auto issued = chrono::steady_clock::now();
+            if(options.rate > 0){
+                issued = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(idx / options.rate));
+                this_thread::sleep_until(issued);
+            }
+            output.str({});
+            const size_t type = GetRequestType(request);
+            if(type == 0){
+                PrintStopResult(request,response_cache,output);
+            }
+            else if(type == 1){
+                PrintBusResult(request,response_cache,output);
+            }
+            else{
+                PrintRouteResult(request,transport_system,output);
+            }
+            const auto finished = chrono::steady_clock::now();
+            worker_samples.push_back({type,chrono::duration<double,micro>(finished - issued).count()});
+        }
+    };
+    vector<thread> threads;
+    for(size_t worker_idx = 1; worker_idx < options.concurrency; worker_idx++){
+        threads.emplace_back(worker,worker_idx);
+    }
+    worker(0);
+    for(auto& thread : threads){
+        thread.join();
+    }
+    const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> latencies[3];
+    for(const auto& worker_samples : samples){
+        for(const auto& sample : worker_samples){
+            latencies[sample.type].push_back(sample.latency_us);
+        }
+    }
+    cout << setprecision(6) << "{" << endl;
+    cout << "  \"requests\": " << total << "," << endl;
+    cout << "  \"concurrency\": " << options.concurrency << "," << endl;
+    cout << "  \"elapsed_s\": " << elapsed << "," << endl;
+    cout << "  \"throughput_rps\": " << (elapsed > 0 ? total / elapsed : 0.0) << "," << endl;
+    cout << "  \"peak_rss_kb\": " << GetPeakRssKb() << "," << endl;
+    cout << "  \"latency_us\": {" << endl;
+    for(size_t type = 0; type < 3; type++){
+        auto& values = latencies[type];
+        sort(values.begin(),values.end());
+        cout << "    \"" << Request_Types[type] << "\": {\"count\": " << values.size()
+             << ", \"p50\": " << Percentile(values,0.5)
+             << ", \"p90\": " << Percentile(values,0.9)
+             << ", \"p99\": " << Percentile(values,0.99)
+             << ", \"p99.9\": " << Percentile(values,0.999)
+             << ", \"max\": " << (values.empty() ? 0.0 : values.back()) << "}"
+             << (type + 1 < 3 ? "," : "") << endl;
+    }
+    size_t switch_mismatches = 0;
+    if(!options.switch_settings.empty()){
+        switch_mismatches = CountSwitchMismatches(stats_request,transport_system,stops_base,bus_base,
+            routing_options,options.switch_settings);
+        cout << "  }," << endl;
+        cout << "  \"switch_settings_mismatches\": " << switch_mismatches << endl;
+    }
+    else{
+        cout << "  }" << endl;
+    }
+    cout << "}" << endl;
+    if(Profile::IsEnabled()){
+        transport_system.ReportRouteCacheStats();
+        Profile::PrintReport(cerr);
+    }
+    return switch_mismatches == 0 ? 0 : 1;
+}
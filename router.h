@@ -19,7 +19,8 @@ namespace Graph {
     using Graph = DirectedWeightedGraph<Weight>;
 
   public:
-    Router(const Graph& graph);
+    // Intermediate vertices are relaxed in rank order, which decides between equal-weight routes.
+    Router(const Graph& graph, const VertexRanks& ranks = {});
 
     using RouteId = uint64_t;
 
@@ -30,8 +31,11 @@ namespace Graph {
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Same as BuildRoute, but writes the edges to the caller's buffer and keeps no state, so it is safe to call concurrently.
+    std::optional<Weight> BuildRouteEdges(VertexId from, VertexId to, std::vector<EdgeId>& edges) const;
     EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
     void ReleaseRoute(RouteId route_id);
+    size_t GetMemoryBytes() const;
 
   private:
     const Graph& graph_;
@@ -92,37 +96,50 @@ namespace Graph {
 
 
   template <typename Weight>
-  Router<Weight>::Router(const Graph& graph)
+  Router<Weight>::Router(const Graph& graph, const VertexRanks& ranks)
       : graph_(graph),
         routes_internal_data_(graph.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
   {
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
+    std::vector<VertexId> relax_order(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+      relax_order[GetVertexRank(ranks, vertex)] = vertex;
+    }
+    for (const VertexId vertex_through : relax_order) {
       RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
     }
   }
 
   template <typename Weight>
-  std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
+  std::optional<Weight> Router<Weight>::BuildRouteEdges(VertexId from, VertexId to, std::vector<EdgeId>& edges) const {
     const auto& route_internal_data = routes_internal_data_[from][to];
     if (!route_internal_data) {
       return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
+    edges.clear();
     for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
          edge_id;
          edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge) {
       edges.push_back(*edge_id);
     }
     std::reverse(std::begin(edges), std::end(edges));
+    return route_internal_data->weight;
+  }
+
+  template <typename Weight>
+  std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    std::vector<EdgeId> edges;
+    const auto weight = BuildRouteEdges(from, to, edges);
+    if (!weight) {
+      return std::nullopt;
+    }
 
     const RouteId route_id = next_route_id_++;
     const size_t route_edge_count = edges.size();
     expanded_routes_cache_[route_id] = std::move(edges);
-    return RouteInfo{route_id, weight, route_edge_count};
+    return RouteInfo{route_id, *weight, route_edge_count};
   }
 
   template <typename Weight>
@@ -130,6 +147,13 @@ namespace Graph {
     return expanded_routes_cache_.at(route_id)[edge_idx];
   }
 
+  template <typename Weight>
+  size_t Router<Weight>::GetMemoryBytes() const {
+    const size_t vertex_count = routes_internal_data_.size();
+    return vertex_count * (sizeof(std::vector<std::optional<RouteInternalData>>)
+                           + vertex_count * sizeof(std::optional<RouteInternalData>));
+  }
+
   template <typename Weight>
   void Router<Weight>::ReleaseRoute(RouteId route_id) {
     expanded_routes_cache_.erase(route_id);
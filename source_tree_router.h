@@ -0,0 +1,109 @@
+#pragma once
+
+#include "dijkstra.h"
+#include "graph.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+  // No preprocessing: a query computes the whole shortest path tree of its source and keeps
+  // it in a bounded LRU cache, so later queries from the same source only walk the tree.
+  template <typename Weight>
+  class SourceTreeRouter {
+  private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+  public:
+    static constexpr size_t DEFAULT_TREE_CACHE_SIZE = 256;
+
+    explicit SourceTreeRouter(const Graph& graph, size_t tree_cache_size = DEFAULT_TREE_CACHE_SIZE,
+                              VertexRanks ranks = {});
+
+    struct RouteInfo {
+      Weight weight;
+      std::vector<EdgeId> edges;
+    };
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to, SearchStats* stats = nullptr) const;
+
+    size_t GetMemoryBytes() const;
+
+  private:
+    struct Tree {
+      std::vector<std::optional<Weight>> distances;
+      std::vector<EdgeId> parent_edges;
+    };
+
+    const Graph& graph_;
+    size_t tree_cache_size_;
+    VertexRanks ranks_;
+
+    mutable std::mutex cache_mutex_;
+    mutable std::list<std::pair<VertexId, std::shared_ptr<const Tree>>> cache_order_;
+    mutable std::unordered_map<VertexId, typename decltype(cache_order_)::iterator> cache_index_;
+
+    std::shared_ptr<const Tree> GetTree(VertexId from, SearchStats* stats) const;
+  };
+
+
+  template <typename Weight>
+  SourceTreeRouter<Weight>::SourceTreeRouter(const Graph& graph, size_t tree_cache_size, VertexRanks ranks)
+      : graph_(graph), tree_cache_size_(std::max<size_t>(1, tree_cache_size)), ranks_(std::move(ranks))
+  {
+  }
+
+  template <typename Weight>
+  std::shared_ptr<const typename SourceTreeRouter<Weight>::Tree> SourceTreeRouter<Weight>::GetTree(VertexId from, SearchStats* stats) const {
+    {
+      std::lock_guard<std::mutex> guard(cache_mutex_);
+      if (auto it = cache_index_.find(from); it != cache_index_.end()) {
+        cache_order_.splice(cache_order_.begin(), cache_order_, it->second);
+        return it->second->second;
+      }
+    }
+
+    auto tree = std::make_shared<Tree>();
+    ComputeShortestPathTree(graph_, from, tree->distances, tree->parent_edges, stats, ranks_);
+
+    std::lock_guard<std::mutex> guard(cache_mutex_);
+    if (cache_index_.count(from) == 0) {
+      cache_order_.emplace_front(from, tree);
+      cache_index_[from] = cache_order_.begin();
+      if (cache_order_.size() > tree_cache_size_) {
+        cache_index_.erase(cache_order_.back().first);
+        cache_order_.pop_back();
+      }
+    }
+    return tree;
+  }
+
+  template <typename Weight>
+  std::optional<typename SourceTreeRouter<Weight>::RouteInfo> SourceTreeRouter<Weight>::BuildRoute(VertexId from, VertexId to, SearchStats* stats) const {
+    const auto tree = GetTree(from, stats);
+    if (!tree->distances[to]) {
+      return std::nullopt;
+    }
+    RouteInfo route{*tree->distances[to], {}};
+    for (VertexId vertex = to; vertex != from; ) {
+      const EdgeId edge_id = tree->parent_edges[vertex];
+      route.edges.push_back(edge_id);
+      vertex = graph_.GetEdge(edge_id).from;
+    }
+    std::reverse(route.edges.begin(), route.edges.end());
+    return route;
+  }
+
+  template <typename Weight>
+  size_t SourceTreeRouter<Weight>::GetMemoryBytes() const {
+    std::lock_guard<std::mutex> guard(cache_mutex_);
+    return cache_order_.size() * graph_.GetVertexCount() * (sizeof(std::optional<Weight>) + sizeof(EdgeId));
+  }
+}